@@ -0,0 +1,156 @@
+#include "benches.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "component_creator.h"
+#include "engine.h"
+#include "slab_heap.h"
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Per thread, the worlds of the bench are stepped in parallel
+	thread_local std::mt19937 rng(1);
+	thread_local int respawns = 0;
+
+	class ChurnBody final : public fen::Component
+	{
+	public:
+
+		static constexpr bool relocatable = true;
+
+		double x{ 0.0 };
+		double v{ 1.0 };
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+
+		void Update(const double dt) override
+		{
+			x += v * dt;
+			if (rng() % 1000 == 0)
+			{
+				owner->Destroy();
+				++respawns;
+			}
+		}
+	};
+
+	class ChurnPayload final : public fen::Component
+	{
+	public:
+
+		static constexpr bool relocatable = true;
+
+		std::uint64_t data[12]{};
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+		void Update(double) override { ++data[0]; }
+	};
+
+	ADD_COMPONENT(ChurnBody)
+	ADD_COMPONENT(ChurnPayload)
+
+	void add_body(fen::Engine& world)
+	{
+		auto& e = world.add_entity();
+		e.add_component<ChurnBody>();
+		if (rng() % 2 == 0)
+			e.add_component<ChurnPayload>();
+	}
+
+	template<typename Func>
+	double run_threads(const unsigned threads, Func&& func)
+	{
+		const auto start = Clock::now();
+		std::vector<std::thread> pool;
+		for (unsigned t = 0; t < threads; ++t)
+			pool.emplace_back([&func, t] { func(t); });
+		for (auto& thread : pool)
+			thread.join();
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Every thread keeps a window of blocks of component sizes alive and replaces one at random per operation
+	void heap_churn(const unsigned threads)
+	{
+		constexpr int window = 4096;
+		constexpr int operations = 2'000'000;
+
+		const double seconds = run_threads(threads, [](const unsigned t)
+		{
+			std::mt19937 local(t + 1);
+			std::vector<std::pair<void*, std::size_t>> live(window, { nullptr, 0 });
+			for (int i = 0; i < operations; ++i)
+			{
+				auto& [ptr, size] = live[local() % window];
+				if (ptr != nullptr)
+					fen::SlabHeap::deallocate(ptr, size);
+				size = 16 + local() % 240;
+				ptr = fen::SlabHeap::allocate(size);
+			}
+			for (const auto& [ptr, size] : live)
+			{
+				if (ptr != nullptr)
+					fen::SlabHeap::deallocate(ptr, size);
+			}
+		});
+
+		std::printf("heap churn, %u threads: %.1f ns per allocation and free, %.1f M per second in total\n",
+			threads, seconds * 1e9 / operations, threads * operations / seconds * 1e-6);
+	}
+
+	// One world per thread, 20000 entities each with 0.1% destroyed and respawned per frame
+	void world_churn(const unsigned threads)
+	{
+		constexpr int entities = 20000;
+		constexpr int frames = 300;
+
+		std::vector<std::unique_ptr<fen::Engine>> worlds;
+		for (unsigned t = 0; t < threads; ++t)
+		{
+			worlds.push_back(std::make_unique<fen::Engine>());
+			worlds.back()->set_fixed_dt(0.016);
+		}
+
+		const double seconds = run_threads(threads, [&worlds](const unsigned t)
+		{
+			auto& world = *worlds[t];
+			for (int i = 0; i < entities; ++i)
+				add_body(world);
+			world.init();
+
+			for (int f = 0; f < frames; ++f)
+			{
+				world.step();
+				for (; respawns > 0; --respawns)
+					add_body(world);
+			}
+		});
+
+		std::printf("world churn, %u worlds in parallel: %.2f ms per frame\n", threads, seconds * 1e3 / frames);
+	}
+}
+
+// Churns the SlabHeap directly and through worlds, on 1 to 8 threads at once
+void bench_heap()
+{
+	for (const unsigned threads : { 1u, 2u, 4u, 8u })
+		heap_churn(threads);
+	for (const unsigned threads : { 1u, 2u, 4u, 8u })
+		world_churn(threads);
+}
@@ -0,0 +1,32 @@
+#include "benches.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	struct Bench
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	constexpr Bench benches[] = {
+		{ "heap", &bench_heap },
+	};
+}
+
+int run_bench(const char* name)
+{
+	for (const auto& bench : benches)
+	{
+		if (std::strcmp(bench.name, name) != 0)
+			continue;
+
+		bench.run();
+		return 0;
+	}
+
+	std::printf("unknown bench %s\n", name);
+	return 1;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+/**
+ * \brief Runs the benchmark called name, see main for the list. Prints its timings
+ * \return Process exit code: 0, or 1 for an unknown name
+ */
+int run_bench(const char* name);
+
+// One per bench_*.cpp
+void bench_heap();
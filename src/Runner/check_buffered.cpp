@@ -0,0 +1,189 @@
+#include "checks.h"
+
+#include <atomic>
+#include <cstdio>
+#include <set>
+#include <vector>
+
+#include "buffered_component.h"
+#include "component_creator.h"
+#include "engine.h"
+
+namespace
+{
+	// Frame being stepped, set before every step. Read only during the buffered pass
+	int frame = 0;
+
+	// Updated from the pool threads
+	std::atomic<int> stale_reads{ 0 };
+	std::atomic<int> writes{ 0 };
+
+	struct ParticleState
+	{
+		double x{ 0.0 };
+		double v{ 0.0 };
+		int written{ 0 };
+	};
+
+	class Particle final : public fen::BufferedComponent<ParticleState>
+	{
+	public:
+
+		std::vector<const Particle*> neighbours;
+		int index{ 0 };
+
+		void Destroy() override {}
+
+		void seed(const double x) { write().x = x; }
+
+		// Some skip a frame, their state is carried over when they write again
+		[[nodiscard]] bool writes_in(const int f) const { return (index + f) % 3 != 0; }
+
+		// 0 for the seeded state
+		[[nodiscard]] int last_write_before(const int f) const
+		{
+			for (int g = f - 1; g > 0; --g)
+			{
+				if (writes_in(g))
+					return g;
+			}
+			return 0;
+		}
+
+	protected:
+
+		void Init() override {}
+
+		void Update(const double dt) override
+		{
+			// Whether they were updated earlier in this pass or not, the state read is the last one written before this frame
+			double force = 0.0;
+			for (const auto n : neighbours)
+			{
+				if (n->read().written != n->last_write_before(frame))
+					++stale_reads;
+				force += n->read().x - read().x;
+			}
+
+			if (!writes_in(frame))
+				return;
+
+			auto& s = write();
+			s.v += force * dt;
+			s.x += s.v * dt;
+			write().written = frame;
+			++writes;
+		}
+	};
+
+	// Updated in the first pass, it only sees committed states
+	class ParticleProbe final : public fen::Component
+	{
+	public:
+
+		const Particle* particle{ nullptr };
+		double seen{ 0.0 };
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+		void Update(double) override { seen += particle->read().x; }
+	};
+
+	ADD_COMPONENT(Particle)
+	ADD_COMPONENT(ParticleProbe)
+
+	struct Run
+	{
+		std::vector<double> states;
+		int stale_reads{ 0 };
+		int missed_reports{ 0 };
+		int repeated_reports{ 0 };
+	};
+
+	Run simulate(const unsigned threads)
+	{
+		constexpr int particles = 5000;
+		constexpr int frames = 200;
+
+		fen::Engine world;
+		world.set_fixed_dt(0.01);
+		world.set_update_threads(threads);
+
+		std::vector<Particle*> ps;
+		for (int i = 0; i < particles; ++i)
+		{
+			auto& e = world.add_entity();
+			e.add_component<Particle>();
+			ps.push_back(e.get_component<Particle>());
+			ps.back()->index = i;
+			ps.back()->seed(i % 17);
+		}
+		for (int i = 0; i < particles; ++i)
+		{
+			for (const int k : { 1, 7, 31, particles - 1 })
+				ps[i]->neighbours.push_back(ps[(i + k) % particles]);
+		}
+
+		std::vector<ParticleProbe*> probes;
+		for (int i = 0; i < particles; i += 100)
+		{
+			auto& e = world.add_entity();
+			e.add_component<ParticleProbe>();
+			probes.push_back(e.get_component<ParticleProbe>());
+			probes.back()->particle = ps[i];
+		}
+
+		Run run;
+		stale_reads = 0;
+		world.init();
+		for (frame = 1; frame <= frames; ++frame)
+		{
+			writes = 0;
+			world.step();
+
+			// The writes of the frame are published once each
+			std::set<const Particle*> reported;
+			world.for_each<fen::changed<Particle>>([&](fen::Entity&, const Particle& p)
+			{
+				if (!reported.insert(&p).second)
+					++run.repeated_reports;
+			});
+			if (frame > 1 && static_cast<int>(reported.size()) != writes)
+				++run.missed_reports;
+		}
+
+		for (const auto p : ps)
+		{
+			run.states.push_back(p->read().x);
+			run.states.push_back(p->read().v);
+		}
+		for (const auto p : probes)
+			run.states.push_back(p->seen);
+		run.stale_reads = stale_reads;
+		return run;
+	}
+}
+
+// Steps the same world of double buffered particles without update threads and with 1 and 4. Reads during the pass
+// must return the previous frame, each write must be reported once as a change, and every run must end in the same state
+bool check_buffered()
+{
+	const auto serial = simulate(0);
+	bool ok = serial.stale_reads == 0 && serial.missed_reports == 0 && serial.repeated_reports == 0;
+	std::printf("buffered: no threads, %d stale reads, %d frames with missed reports, %d repeated reports\n",
+		serial.stale_reads, serial.missed_reports, serial.repeated_reports);
+
+	for (const unsigned threads : { 1u, 4u })
+	{
+		const auto parallel = simulate(threads);
+		const bool same = parallel.states == serial.states;
+		ok = ok && same && parallel.stale_reads == 0 && parallel.missed_reports == 0 && parallel.repeated_reports == 0;
+		std::printf("buffered: %u threads, %d stale reads, %d frames with missed reports, %d repeated reports, state %s\n",
+			threads, parallel.stale_reads, parallel.missed_reports, parallel.repeated_reports, same ? "equal" : "DIFFERENT");
+	}
+
+	return ok;
+}
@@ -0,0 +1,94 @@
+#include "checks.h"
+
+#include <cstdio>
+#include <memory>
+
+#include "component_creator.h"
+#include "engine.h"
+#include "memory_stats.h"
+
+namespace
+{
+	class HeapBody final : public fen::Component
+	{
+	public:
+
+		double x{ 0.0 };
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+
+		void Update(const double dt) override
+		{
+			x += dt;
+			mark_changed();
+		}
+	};
+
+	ADD_COMPONENT(HeapBody)
+
+	constexpr std::size_t bodies = 2000;
+
+	std::unique_ptr<fen::Engine> make_world()
+	{
+		auto world = std::make_unique<fen::Engine>();
+		world->set_fixed_dt(0.016);
+
+		fen::Capacities capacities;
+		capacities.entities = 2 * bodies;
+		capacities.pending = 100;
+		capacities.warmup_frames = 5;
+		capacities.policy = fen::CapacityPolicy::Grow;
+		capacities.set<HeapBody>(2 * bodies);
+		world->reserve(capacities);
+
+		for (std::size_t i = 0; i < bodies; ++i)
+			world->add_entity().add_component<HeapBody>();
+		world->init();
+		return world;
+	}
+
+	std::int64_t slab_bytes() { return fen::MemoryStats::get(fen::MemoryTag::Slabs).live_bytes.get(); }
+}
+
+// Two worlds reserve and seal the SlabHeap. It must stay sealed until both are gone, the steady state must not overflow,
+// and the spare slabs must go back to the system with the last world
+bool check_heap()
+{
+	// The slabs being filled are kept. A first world leaves them for every size class the worlds use
+	make_world()->step();
+	const auto bytes_before = slab_bytes();
+	const auto overflows_before = fen::SlabHeap::overflows();
+
+	auto first = make_world();
+	auto second = make_world();
+	for (int f = 0; f < 100; ++f)
+	{
+		first->step();
+		second->step();
+	}
+	const bool sealed_by_both = fen::SlabHeap::is_sealed();
+	const auto steady_overflows = fen::SlabHeap::overflows() - overflows_before;
+
+	first.reset();
+	const bool sealed_by_one = fen::SlabHeap::is_sealed();
+	for (int f = 0; f < 100; ++f)
+		second->step();
+	const auto overflows_after_one = fen::SlabHeap::overflows() - overflows_before;
+
+	const auto bytes_with_one = slab_bytes();
+	second.reset();
+	const bool unsealed = !fen::SlabHeap::is_sealed();
+	const auto bytes_after = slab_bytes();
+
+	std::printf("heap: sealed %s with two worlds, %s with one, %s with none. %llu overflows in steady state, %llu once a world is gone\n",
+		sealed_by_both ? "yes" : "no", sealed_by_one ? "yes" : "no", unsealed ? "no" : "yes",
+		static_cast<unsigned long long>(steady_overflows), static_cast<unsigned long long>(overflows_after_one));
+	std::printf("heap: %lld slab bytes before, %lld with one world, %lld after\n",
+		static_cast<long long>(bytes_before), static_cast<long long>(bytes_with_one), static_cast<long long>(bytes_after));
+
+	return sealed_by_both && sealed_by_one && unsealed && steady_overflows == 0 && overflows_after_one == 0 && bytes_after <= bytes_before;
+}
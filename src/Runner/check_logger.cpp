@@ -0,0 +1,65 @@
+#include "checks.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "logger.h"
+
+// Logs bursts of records of varying sizes through a 1 KiB ring, so the wrap lands on every offset, and checks that
+// every record comes out once and in order
+bool check_logger()
+{
+	std::FILE* out = std::tmpfile();
+	if (out == nullptr)
+		return false;
+
+	fen::Logger::flush();
+	fen::Logger::set_output(out);
+	fen::Logger::set_ring_size(1024);
+	const auto dropped = fen::Logger::dropped();
+
+	constexpr int bursts = 2000;
+	int logged = 0;
+
+	// A new thread, so it gets a ring of the new size
+	std::thread([&logged]
+	{
+		const std::string pad(64, 'x');
+		for (int burst = 0; burst < bursts; ++burst)
+		{
+			for (int i = 0; i <= burst % 11; ++i, ++logged)
+				FEN_LOG_INFO("seq {} pad {}", logged, std::string_view(pad).substr(0, (logged * 7) % 41));
+			fen::Logger::flush();
+		}
+	}).join();
+
+	fen::Logger::flush();
+	fen::Logger::set_output(stderr);
+
+	std::rewind(out);
+	char line[256];
+	int expected = 0;
+	bool ok = true;
+	while (std::fgets(line, sizeof(line), out) != nullptr)
+	{
+		const char* seq = std::strstr(line, "seq ");
+		if (seq == nullptr)
+			continue;
+
+		const int n = std::atoi(seq + 4);
+		const auto pad = std::strstr(seq, "pad ");
+		const auto pad_len = pad != nullptr ? std::strcspn(pad + 4, "\n") : 0;
+		if (n != expected || pad_len != static_cast<std::size_t>((n * 7) % 41))
+			ok = false;
+		++expected;
+	}
+	std::fclose(out);
+
+	ok &= expected == logged && fen::Logger::dropped() == dropped;
+	std::printf("logger: %d records logged, %d read back in order, %llu dropped\n", logged, expected,
+		static_cast<unsigned long long>(fen::Logger::dropped() - dropped));
+	return ok;
+}
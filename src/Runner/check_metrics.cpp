@@ -0,0 +1,167 @@
+#include "checks.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "component_creator.h"
+#include "engine.h"
+#include "metrics.h"
+#include "metrics_exporter.h"
+
+namespace
+{
+	class MeteredBody final : public fen::Component
+	{
+	public:
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+		void Update(double) override {}
+	};
+
+	class MeteredTag final : public fen::Component
+	{
+	public:
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+		void Update(double) override {}
+	};
+
+	ADD_COMPONENT(MeteredBody)
+	ADD_COMPONENT(MeteredTag)
+
+	// Samples by name and labels, i.e: fen_components{world="a",type="MeteredBody"}. Empty if the text is malformed:
+	// a sample without a value or before the HELP and TYPE of its family
+	std::map<std::string, double> parse(const std::string& text)
+	{
+		std::map<std::string, double> samples;
+		std::set<std::string> described;
+		std::set<std::string> typed;
+
+		std::istringstream in(text);
+		std::string line;
+		while (std::getline(in, line))
+		{
+			std::istringstream words(line);
+			std::string first;
+			words >> first;
+			if (first == "#")
+			{
+				std::string kind;
+				std::string name;
+				words >> kind >> name;
+				std::string type;
+				if (kind == "HELP")
+					described.insert(name);
+				else if (kind == "TYPE" && words >> type && (type == "counter" || type == "gauge"))
+					typed.insert(name);
+				continue;
+			}
+
+			const auto name = first.substr(0, first.find('{'));
+			double value = 0.0;
+			if (!(words >> value) || !described.contains(name) || !typed.contains(name) || samples.contains(first))
+				return {};
+			samples[first] = value;
+		}
+		return samples;
+	}
+
+	std::string scrape(const fen::MetricsRegistry& registry)
+	{
+		std::ostringstream out;
+		registry.write_prometheus(out);
+		return out.str();
+	}
+
+	std::string components(const char* world, const char* type)
+	{
+		return std::string("fen_components{world=\"") + world + "\",type=\"" + type + "\"}";
+	}
+}
+
+// Two worlds exported to one registry add and remove entities and components. The scraped text must parse and hold
+// their counts, a destroyed world must disappear from it, and the file written by the exporter must match it
+bool check_metrics()
+{
+	fen::MetricsRegistry registry;
+	auto& owned = registry.add_counter("fen_check_milliseconds_total", "Registry owned counter", "", 1e-3);
+	owned.add(1500);
+
+	fen::Engine a;
+	auto b = std::make_unique<fen::Engine>();
+	a.register_metrics(registry, "a");
+	b->register_metrics(registry, "b");
+
+	for (int i = 0; i < 300; ++i)
+		a.add_entity().add_component<MeteredBody>();
+	for (int i = 0; i < 50; ++i)
+		b->add_entity().add_component<MeteredTag>();
+	a.init();
+	b->init();
+	a.step();
+
+	// Moved into the world by init
+	std::vector<fen::Entity*> bodies;
+	a.for_each<fen::added<MeteredBody>>([&bodies](fen::Entity& e, MeteredBody&) { bodies.push_back(&e); });
+	if (bodies.size() != 300)
+		return false;
+
+	// Removes 100 entities and 50 bodies, and tags 30 live entities
+	for (int i = 0; i < 300; ++i)
+	{
+		if (i % 3 == 0)
+			bodies[i]->Destroy();
+		else if (i % 4 == 0)
+			bodies[i]->destroy_component<MeteredBody>();
+		else if (i % 5 == 0)
+			bodies[i]->add_component<MeteredTag>();
+	}
+	a.step();
+	a.step();
+	b->step();
+
+	auto samples = parse(scrape(registry));
+	const bool counted = samples[components("a", "MeteredBody")] == 150 && samples[components("a", "MeteredTag")] == 30 &&
+		samples["fen_entities{world=\"a\"}"] == 200 && samples["fen_frames_total{world=\"a\"}"] == 3 &&
+		samples[components("b", "MeteredTag")] == 50 && samples[components("b", "MeteredBody")] == 0 &&
+		samples["fen_frames_total{world=\"b\"}"] == 1 && samples["fen_check_milliseconds_total"] == 1.5;
+
+	b.reset();
+	samples = parse(scrape(registry));
+	const bool detached = !samples.empty() && !samples.contains(components("b", "MeteredTag")) &&
+		samples.contains(components("a", "MeteredTag"));
+
+	// The exporter writes the file on start, every period and on shutdown
+	const auto file = (std::filesystem::temp_directory_path() / "fen_check_metrics.prom").string();
+	{
+		fen::MetricsExporter exporter(registry, { file, 0.01 });
+		for (int f = 0; f < 20; ++f)
+			a.step();
+	}
+	std::ifstream in(file);
+	const std::string dumped((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+	const bool exported = !dumped.empty() && parse(dumped) == parse(scrape(registry)) && !std::filesystem::exists(file + ".tmp");
+	std::filesystem::remove(file);
+
+	std::printf("metrics: %zu samples, counts %s, destroyed world %s, exported file %s\n", samples.size(),
+		counted ? "ok" : "WRONG", detached ? "gone" : "STILL THERE", exported ? "equal" : "DIFFERENT");
+
+	return counted && detached && exported;
+}
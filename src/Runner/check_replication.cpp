@@ -0,0 +1,317 @@
+#include "checks.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "bit_stream.h"
+#include "component_creator.h"
+#include "engine.h"
+#include "field_layout.h"
+#include "replication.h"
+
+namespace
+{
+	std::mt19937 rng(7);
+
+	// Only the components of the source world move, the replica gets their state through the packets
+	bool authoritative = false;
+	int respawns = 0;
+
+	enum class Mode : std::uint8_t { Idle, Walk, Run };
+
+	class ReplicatedBody final : public fen::Component
+	{
+	public:
+
+		static inline std::set<ReplicatedBody*> live;
+
+		int uid{ -1 };
+		float x{ 0.0f };
+		float y{ 0.0f };
+		std::int16_t hp{ 100 };
+		bool alive{ true };
+		Mode mode{ Mode::Idle };
+		double exact{ 0.0 };
+
+		static constexpr auto replicated_fields = fen::layout(fen::field(&ReplicatedBody::uid, 32),
+			fen::quantized(&ReplicatedBody::x, -1000.0, 1000.0, 20), fen::quantized(&ReplicatedBody::y, -1000.0, 1000.0, 20),
+			fen::field(&ReplicatedBody::hp, 10), fen::field(&ReplicatedBody::alive), fen::field(&ReplicatedBody::mode, 2),
+			fen::field(&ReplicatedBody::exact));
+
+		ReplicatedBody() { live.insert(this); }
+		ReplicatedBody(ReplicatedBody&& other) = default;
+		~ReplicatedBody() override { live.erase(this); }
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override
+		{
+			if (authoritative)
+				uid = static_cast<int>(owner->get_id());
+		}
+
+		void Update(double) override
+		{
+			if (!authoritative)
+				return;
+
+			const auto r = rng() % 100;
+			if (r < 10)
+			{
+				x += 1.5f;
+				y -= 0.25f;
+				mark_changed();
+			}
+			else if (r < 12)
+			{
+				hp = static_cast<std::int16_t>(hp - 7);
+				mode = Mode::Run;
+				exact += 1e-9;
+				mark_changed();
+			}
+			else if (r < 13)
+			{
+				owner->Destroy();
+				++respawns;
+			}
+			else if (r < 14)
+			{
+				// Written without changing
+				mark_changed();
+			}
+		}
+	};
+
+	// Replicates its existence only
+	class ReplicatedTag final : public fen::Component
+	{
+	public:
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+
+		void Update(double) override
+		{
+			if (authoritative && rng() % 300 == 0)
+				owner->destroy_component<ReplicatedTag>();
+		}
+	};
+
+	ADD_COMPONENT(ReplicatedBody)
+	ADD_COMPONENT(ReplicatedTag)
+
+	using BodyState = std::tuple<std::int64_t, std::int64_t, int, bool, int, double, bool>;
+
+	std::map<int, BodyState> state_of(const fen::Engine& world)
+	{
+		std::map<int, BodyState> state;
+		for (const auto body : ReplicatedBody::live)
+		{
+			const auto owner = body->get_owner();
+			if (owner == nullptr || owner->get_world() != &world)
+				continue;
+
+			state[body->uid] = { std::llround(body->x * 100), std::llround(body->y * 100), body->hp, body->alive,
+				static_cast<int>(body->mode), body->exact, owner->get_component<ReplicatedTag>() != nullptr };
+		}
+		return state;
+	}
+
+	// Every body of the process, initialized or not, so a rejected packet that created or wrote one shows
+	double digest()
+	{
+		double sum = static_cast<double>(ReplicatedBody::live.size());
+		for (const auto body : ReplicatedBody::live)
+			sum += body->uid * 3.0 + body->x + body->y * 7.0 + body->hp + body->exact;
+		return sum;
+	}
+
+	void add_body(fen::Engine& world)
+	{
+		auto& e = world.add_entity();
+		e.add_component<ReplicatedBody>();
+		if (rng() % 2 != 0)
+			e.add_component<ReplicatedTag>();
+		e.set_erase_on_no_components(true);
+	}
+
+	void step_source(fen::Engine& world)
+	{
+		authoritative = true;
+		world.step();
+		authoritative = false;
+		for (; respawns > 0; --respawns)
+			add_body(world);
+	}
+
+	bool check_bit_stream()
+	{
+		std::vector<std::uint8_t> buffer;
+		std::vector<std::pair<std::uint64_t, unsigned>> written;
+		std::mt19937_64 values(1);
+
+		fen::BitWriter writer(buffer);
+		for (int i = 0; i < 10000; ++i)
+		{
+			const unsigned bits = 1 + values() % 64;
+			const auto value = values() & (bits == 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << bits) - 1);
+			written.emplace_back(value, bits);
+			if (i % 3 != 0)
+				writer.write(value, bits);
+			else
+				writer.write_varint(value);
+		}
+		writer.flush();
+
+		fen::BitReader reader(buffer.data(), buffer.size());
+		int i = 0;
+		for (const auto& [value, bits] : written)
+		{
+			if ((i++ % 3 != 0 ? reader.read(bits) : reader.read_varint()) != value)
+				return false;
+		}
+		return !reader.has_failed();
+	}
+}
+
+// Replicates 2000 entities for 600 frames over a link that loses, reorders and truncates packets and delays the
+// acknowledgements. The replica must match the source whenever it reaches the source tick, and truncated packets must
+// be rejected without changing it
+bool check_replication()
+{
+	const bool bit_stream = check_bit_stream();
+
+	fen::Engine source;
+	fen::Engine replica;
+	source.set_fixed_dt(0.016);
+	replica.set_fixed_dt(0.016);
+
+	for (int i = 0; i < 2000; ++i)
+		add_body(source);
+	authoritative = true;
+	source.init();
+	authoritative = false;
+	for (int f = 0; f < 5; ++f)
+		step_source(source);
+
+	fen::Replicator replicator(source);
+	fen::ReplicaReceiver receiver(replica);
+	const auto observer = replicator.add_observer();
+	replica.init();
+
+	constexpr int frames = 600;
+	std::size_t delta_bytes = 0;
+	std::size_t full_bytes = 0;
+	std::size_t applied = 0;
+	std::size_t rejected = 0;
+	std::size_t compared = 0;
+	std::size_t mismatches = 0;
+	std::size_t truncated_accepted = 0;
+	std::size_t truncated_changed = 0;
+
+	// Acknowledgements arrive some frames late: frame, tick
+	std::vector<std::pair<int, std::uint32_t>> acks;
+	std::vector<std::vector<std::uint8_t>> in_flight;
+
+	for (int f = 0; f < frames; ++f)
+	{
+		step_source(source);
+
+		std::vector<std::uint8_t> packet;
+		replicator.encode(observer, packet);
+		delta_bytes += packet.size();
+
+		// Size of a full state, for comparison
+		const auto fresh = replicator.add_observer();
+		std::vector<std::uint8_t> full;
+		replicator.encode(fresh, full);
+		full_bytes += full.size();
+		replicator.remove_observer(fresh);
+
+		in_flight.push_back(std::move(packet));
+		std::shuffle(in_flight.begin(), in_flight.end(), rng);
+		while (!in_flight.empty() && rng() % 3 != 0)
+		{
+			const auto p = std::move(in_flight.back());
+			in_flight.pop_back();
+
+			// Lost
+			if (rng() % 5 == 0)
+				continue;
+
+			// A truncated copy arrives first
+			if (p.size() > 1)
+			{
+				const auto tick = receiver.get_tick();
+				const auto before = digest();
+				if (receiver.apply(p.data(), 1 + rng() % (p.size() - 1)))
+					++truncated_accepted;
+				if (receiver.get_tick() != tick || digest() != before)
+					++truncated_changed;
+			}
+
+			if (receiver.apply(p.data(), p.size()))
+			{
+				++applied;
+				acks.emplace_back(f + static_cast<int>(rng() % 4), receiver.get_tick());
+			}
+			else
+			{
+				++rejected;
+			}
+		}
+		if (in_flight.size() > 8)
+			in_flight.erase(in_flight.begin(), in_flight.begin() + 4);
+
+		for (auto it = acks.begin(); it != acks.end();)
+		{
+			if (it->first <= f && rng() % 4 != 0)
+			{
+				replicator.acknowledge(observer, it->second);
+				it = acks.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		replica.step();
+		if (receiver.get_tick() == replicator.get_tick())
+		{
+			++compared;
+			if (state_of(source) != state_of(replica))
+				++mismatches;
+		}
+	}
+
+	// Catches up without loss
+	for (int i = 0; i < 3; ++i)
+	{
+		std::vector<std::uint8_t> packet;
+		replicator.encode(observer, packet);
+		(void)receiver.apply(packet.data(), packet.size());
+		replicator.acknowledge(observer, receiver.get_tick());
+		replica.step();
+	}
+	const bool converged = state_of(source) == state_of(replica);
+
+	std::printf("replication: bit stream %s, %zu packets applied, %zu rejected, %zu states compared, %zu mismatches, final state %s\n",
+		bit_stream ? "ok" : "BROKEN", applied, rejected, compared, mismatches, converged ? "equal" : "DIFFERENT");
+	std::printf("replication: truncated packets %zu accepted, %zu changed the replica\n", truncated_accepted, truncated_changed);
+	std::printf("replication: %.1f delta bytes per frame, %.1f full state bytes per frame\n",
+		static_cast<double>(delta_bytes) / frames, static_cast<double>(full_bytes) / frames);
+
+	return bit_stream && mismatches == 0 && converged && compared > 0 && truncated_accepted == 0 && truncated_changed == 0;
+}
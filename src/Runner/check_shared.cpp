@@ -0,0 +1,163 @@
+#include "checks.h"
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "component_creator.h"
+#include "engine.h"
+#include "memory_stats.h"
+#include "reclaimer.h"
+#include "shared_component.h"
+
+namespace
+{
+	struct Loadout
+	{
+		int hp{ 100 };
+		int speed{ 5 };
+
+		bool operator==(const Loadout& other) const = default;
+		auto operator<=>(const Loadout& other) const = default;
+	};
+
+	// Per thread, every world is stepped by its own
+	thread_local std::mt19937 rng(1);
+	thread_local int respawns = 0;
+
+	// Set for the last step, which only adds the respawned entities
+	thread_local bool frozen = false;
+
+	// Few enough values for every thread to intern the same ones
+	Loadout random_loadout() { return { static_cast<int>(rng() % 8) * 10, static_cast<int>(rng() % 3) }; }
+
+	class LoadoutComp final : public fen::SharedComponent<Loadout>
+	{
+	public:
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+
+		void Update(double) override
+		{
+			if (frozen)
+				return;
+
+			const auto r = rng() % 1000;
+			if (r < 5)
+				set(random_loadout());
+			else if (r < 8)
+				modify([](Loadout& l) { l.speed = (l.speed + 1) % 3; });
+			else if (r < 10)
+			{
+				owner->Destroy();
+				++respawns;
+			}
+		}
+	};
+
+	ADD_COMPONENT(LoadoutComp)
+
+	void add_unit(fen::Engine& world)
+	{
+		auto& e = world.add_entity();
+		e.add_component<LoadoutComp>();
+		if (rng() % 4 != 0)
+			e.get_component<LoadoutComp>()->set(random_loadout());
+	}
+
+	// Entities holding each value in the world, and the use count of its reference
+	void count_values(fen::Engine& world, std::map<Loadout, std::uint32_t>& holders, std::map<Loadout, std::uint32_t>& use_counts)
+	{
+		world.for_each_group<LoadoutComp>([&](const Loadout& l, std::span<fen::Entity* const> group)
+		{
+			holders[l] += static_cast<std::uint32_t>(group.size());
+			use_counts[l] = group.front()->get_component<LoadoutComp>()->get_ref().use_count();
+		});
+	}
+}
+
+// Worlds on four threads share the values of their components while they set, modify and destroy them, and free them
+// on a shared reclaimer thread while the other threads intern the same values. The pool must hold one block per value
+// in use, each referenced once per holder, and go back to the default value alone once the worlds are gone
+bool check_shared()
+{
+	using Pool = fen::SharedPool<Loadout>;
+
+	constexpr unsigned threads = 4;
+	constexpr int units = 2000;
+	constexpr int frames = 200;
+
+	// The pool allocates its default value when first used
+	(void)Pool::Instance().size();
+	const auto shared_bytes = fen::MemoryStats::get(fen::MemoryTag::SharedData).live_bytes.get();
+	fen::Reclaimer reclaimer;
+
+	std::vector<std::unique_ptr<fen::Engine>> worlds;
+	for (unsigned t = 0; t < threads; ++t)
+	{
+		worlds.push_back(std::make_unique<fen::Engine>());
+		worlds.back()->set_fixed_dt(0.016);
+		worlds.back()->set_reclaimer(&reclaimer);
+	}
+
+	std::vector<std::thread> stepping;
+	for (unsigned t = 0; t < threads; ++t)
+	{
+		stepping.emplace_back([&world = *worlds[t], t]
+		{
+			rng.seed(t + 1);
+			for (int i = 0; i < units; ++i)
+				add_unit(world);
+			world.init();
+
+			for (int f = 0; f < frames; ++f)
+			{
+				world.step();
+				for (; respawns > 0; --respawns)
+					add_unit(world);
+
+				// Interned and dropped outside the worlds too
+				const fen::SharedRef<Loadout> ref(random_loadout());
+				const auto copy = ref;
+			}
+
+			frozen = true;
+			world.step();
+		});
+	}
+	for (auto& thread : stepping)
+		thread.join();
+	reclaimer.wait_idle();
+
+	std::map<Loadout, std::uint32_t> holders;
+	std::map<Loadout, std::uint32_t> use_counts;
+	for (const auto& world : worlds)
+		count_values(*world, holders, use_counts);
+
+	// The pool keeps a reference to the default value
+	std::size_t wrong_counts = 0;
+	for (const auto& [loadout, n] : holders)
+	{
+		if (use_counts[loadout] != n + (loadout == Loadout{} ? 1 : 0))
+			++wrong_counts;
+	}
+	const auto values = holders.size() + (holders.contains(Loadout{}) ? 0 : 1);
+	const auto pooled = Pool::Instance().size();
+
+	worlds.clear();
+	reclaimer.wait_idle();
+	const auto pooled_after = Pool::Instance().size();
+	const auto bytes_after = fen::MemoryStats::get(fen::MemoryTag::SharedData).live_bytes.get();
+
+	std::printf("shared: %zu values in use, %zu pooled, %zu wrong use counts. %zu pooled once the worlds are gone, %lld bytes left\n",
+		values, pooled, wrong_counts, pooled_after, static_cast<long long>(bytes_after - shared_bytes));
+
+	return pooled == values && wrong_counts == 0 && pooled_after == 1 && bytes_after == shared_bytes;
+}
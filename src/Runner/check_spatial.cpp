@@ -0,0 +1,211 @@
+#include "checks.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "component_creator.h"
+#include "engine.h"
+#include "spatial_index.h"
+
+namespace
+{
+	std::mt19937 rng(11);
+	int respawns = 0;
+
+	// Bodies drift along x for a while, so the occupied cells move instead of only growing
+	float drift = 0.0f;
+
+	float random(const float max) { return static_cast<float>(rng() % 10000) / 10000.0f * max; }
+
+	fen::Vec3 random_position() { return { random(200.0f), random(200.0f), random(10.0f) }; }
+
+	// Moves, resizes, teleports and kills the SpatialBody of its entity
+	class SpatialMover final : public fen::Component
+	{
+	public:
+
+		// Every initialized body of the process by entity, as the index must see it after a step
+		static inline std::map<fen::EntityId, const fen::SpatialBody*> live;
+
+		~SpatialMover() override
+		{
+			if (indexed)
+				live.erase(owner->get_id());
+		}
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override
+		{
+			live[owner->get_id()] = owner->get_component<fen::SpatialBody>();
+			indexed = true;
+		}
+
+		void Update(double) override
+		{
+			const auto body = owner->get_component<fen::SpatialBody>();
+			const auto r = rng() % 100;
+			if (r < 30)
+			{
+				auto p = body->get_position();
+				p.x += random(2.0f) - 1.0f + drift;
+				p.y += random(2.0f) - 1.0f;
+				body->set_position(p);
+			}
+			else if (r < 31)
+			{
+				// A few big ones, so the largest radius has to shrink back when they go
+				body->set_radius(rng() % 50 == 0 ? random(20.0f) : random(3.0f));
+			}
+			else if (r < 32)
+			{
+				body->set_position(random_position());
+			}
+			else if (r < 33)
+			{
+				owner->Destroy();
+				++respawns;
+			}
+		}
+
+	private:
+
+		bool indexed{ false };
+	};
+
+	ADD_COMPONENT(SpatialMover)
+
+	void add_body(fen::Engine& world)
+	{
+		auto& e = world.add_entity();
+		e.add_component<fen::SpatialBody>();
+		e.add_component<SpatialMover>();
+
+		const auto body = e.get_component<fen::SpatialBody>();
+		body->set_position(random_position());
+		body->set_radius(random(1.0f));
+	}
+
+	std::vector<fen::EntityId> brute_radius(const fen::Sphere& q)
+	{
+		std::vector<fen::EntityId> ids;
+		for (const auto& [id, body] : SpatialMover::live)
+		{
+			const auto& p = body->get_position();
+			const float dx = p.x - q.center.x;
+			const float dy = p.y - q.center.y;
+			const float dz = p.z - q.center.z;
+			const float r = q.radius + body->get_radius();
+			if (dx * dx + dy * dy + dz * dz <= r * r)
+				ids.push_back(id);
+		}
+		return ids;
+	}
+
+	std::vector<fen::EntityId> brute_box(const fen::Aabb& q)
+	{
+		std::vector<fen::EntityId> ids;
+		for (const auto& [id, body] : SpatialMover::live)
+		{
+			const auto& p = body->get_position();
+			const float r = body->get_radius();
+			if (p.x - r <= q.max.x && p.x + r >= q.min.x && p.y - r <= q.max.y && p.y + r >= q.min.y && p.z - r <= q.max.z && p.z + r >= q.min.z)
+				ids.push_back(id);
+		}
+		return ids;
+	}
+
+	std::vector<fen::EntityId> hits_of(const std::vector<fen::SpatialEntry>& hits, const std::vector<std::uint32_t>& offsets, const std::size_t q)
+	{
+		std::vector<fen::EntityId> ids;
+		for (auto i = offsets[q]; i < offsets[q + 1]; ++i)
+			ids.push_back(hits[i].id);
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	}
+
+	// Steps a world of 5000 bodies starting with kind, switching to the other halfway, and compares every frame
+	// batches of radius and box queries with a scan of every body
+	bool check_kind(const fen::SpatialIndex::Kind kind, const float size, const fen::SpatialIndex::Kind other, const float other_size)
+	{
+		constexpr int frames = 120;
+		constexpr int queries = 50;
+
+		fen::Engine world;
+		world.set_fixed_dt(0.016);
+		world.set_spatial_index(kind, size);
+		for (int i = 0; i < 5000; ++i)
+			add_body(world);
+		world.init();
+
+		std::size_t checked = 0;
+		std::size_t hits_total = 0;
+		std::size_t mismatches = 0;
+		std::vector<fen::Sphere> spheres;
+		std::vector<fen::Aabb> boxes;
+		std::vector<fen::SpatialEntry> hits;
+		std::vector<std::uint32_t> offsets;
+
+		for (int f = 0; f < frames; ++f)
+		{
+			drift = f < frames / 2 ? 0.5f : -0.5f;
+			if (f == frames / 2)
+				world.set_spatial_index(other, other_size);
+
+			world.step();
+			for (; respawns > 0; --respawns)
+				add_body(world);
+
+			const auto& index = world.get_spatial_index();
+			if (index.size() != SpatialMover::live.size())
+				++mismatches;
+
+			spheres.clear();
+			boxes.clear();
+			for (int q = 0; q < queries; ++q)
+			{
+				const auto center = random_position();
+				spheres.push_back({ center, random(8.0f) });
+				boxes.push_back({ center, { center.x + random(10.0f), center.y + random(10.0f), center.z + random(5.0f) } });
+			}
+
+			hits.clear();
+			index.query_radius(spheres, hits, offsets);
+			for (std::size_t q = 0; q < spheres.size(); ++q)
+			{
+				const auto found = hits_of(hits, offsets, q);
+				hits_total += found.size();
+				mismatches += found != brute_radius(spheres[q]) ? 1 : 0;
+			}
+
+			hits.clear();
+			index.query_box(boxes, hits, offsets);
+			for (std::size_t q = 0; q < boxes.size(); ++q)
+			{
+				const auto found = hits_of(hits, offsets, q);
+				hits_total += found.size();
+				mismatches += found != brute_box(boxes[q]) ? 1 : 0;
+			}
+			checked += spheres.size() + boxes.size();
+		}
+
+		std::printf("spatial: %s then %s, %zu queries, %zu hits, %zu mismatches\n",
+			kind == fen::SpatialIndex::Kind::HashGrid ? "grid" : "tree", other == fen::SpatialIndex::Kind::HashGrid ? "grid" : "tree",
+			checked, hits_total, mismatches);
+		return mismatches == 0 && hits_total > 0;
+	}
+}
+
+// Brute force comparison of the spatial index queries, with 5000 moving, resizing, spawning and dying bodies
+bool check_spatial()
+{
+	using Kind = fen::SpatialIndex::Kind;
+	const bool grid = check_kind(Kind::HashGrid, 4.0f, Kind::LooseBvh, 0.5f);
+	const bool tree = check_kind(Kind::LooseBvh, 0.5f, Kind::HashGrid, 2.0f);
+	return grid && tree;
+}
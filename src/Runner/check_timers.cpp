@@ -0,0 +1,120 @@
+#include "checks.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "component_creator.h"
+#include "engine.h"
+#include "timer_wheel.h"
+
+namespace
+{
+	class TimerProbe final : public fen::Component
+	{
+	public:
+
+		void Destroy() override {}
+
+	protected:
+
+		void Init() override {}
+		void Update(double) override {}
+	};
+
+	ADD_COMPONENT(TimerProbe)
+}
+
+// Inserts, removes and expires components on a TimerWheel with random deadlines, from the next tick to beyond the
+// highest level, and compares every advance with a multimap of the deadlines
+bool check_timers()
+{
+	constexpr int probes = 20000;
+	constexpr int operations = 200000;
+
+	// The wheel only links the components, they are never stepped
+	fen::Engine world;
+	std::vector<fen::Component*> idle;
+	for (int i = 0; i < probes; ++i)
+	{
+		auto& e = world.add_entity();
+		e.add_component<TimerProbe>();
+		idle.push_back(e.get_component<TimerProbe>());
+	}
+
+	std::mt19937_64 rng(1);
+	fen::TimerWheel wheel;
+	std::multimap<std::uint64_t, fen::Component*> reference;
+	fen::SlabVector<fen::Component*, fen::MemoryTag::Queues> expired;
+	std::vector<fen::Component*> expected;
+	std::uint64_t now = 0;
+	std::size_t advances = 0;
+	std::size_t checked = 0;
+	std::size_t mismatches = 0;
+
+	for (int i = 0; i < operations; ++i)
+	{
+		const auto op = rng() % 10;
+		if (op < 4 && !idle.empty())
+		{
+			const auto comp = idle.back();
+			idle.pop_back();
+
+			std::uint64_t deadline = now;
+			switch (rng() % 4)
+			{
+			case 0: deadline += rng() % 70; break;
+			case 1: deadline += rng() % 5000; break;
+			case 2: deadline += rng() % 300000; break;
+			default: deadline += rng() % 40000000; break;
+			}
+			wheel.insert(comp, deadline);
+
+			// Deadlines in the past expire on the next advance
+			reference.emplace(std::max(deadline, now + 1), comp);
+		}
+		else if (op < 5 && !reference.empty())
+		{
+			auto it = reference.begin();
+			std::advance(it, static_cast<std::ptrdiff_t>(rng() % reference.size()));
+			wheel.remove(it->second);
+			idle.push_back(it->second);
+			reference.erase(it);
+		}
+		else
+		{
+			const auto to = now + (rng() % 3 == 0 ? rng() % 100000 : rng() % 50);
+			wheel.advance(to, expired);
+
+			expected.clear();
+			while (!reference.empty() && reference.begin()->first <= to)
+			{
+				expected.push_back(reference.begin()->second);
+				reference.erase(reference.begin());
+			}
+
+			std::sort(expired.begin(), expired.end());
+			std::sort(expected.begin(), expected.end());
+			if (!std::equal(expired.begin(), expired.end(), expected.begin(), expected.end()))
+				++mismatches;
+
+			++advances;
+			checked += expected.size();
+			idle.insert(idle.end(), expired.begin(), expired.end());
+			expired.clear();
+			now = to;
+		}
+
+		if (wheel.size() != reference.size())
+			++mismatches;
+	}
+
+	// Empties the wheel before its components go away
+	for (const auto& [deadline, comp] : reference)
+		wheel.remove(comp);
+
+	std::printf("timers: %zu advances, %zu components expired, %zu mismatches\n", advances, checked, mismatches);
+	return mismatches == 0 && checked > 0;
+}
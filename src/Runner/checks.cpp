@@ -0,0 +1,40 @@
+#include "checks.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	struct Check
+	{
+		const char* name;
+		bool (*run)();
+	};
+
+	constexpr Check checks[] = {
+		{ "buffered", &check_buffered },
+		{ "heap", &check_heap },
+		{ "logger", &check_logger },
+		{ "metrics", &check_metrics },
+		{ "replication", &check_replication },
+		{ "shared", &check_shared },
+		{ "spatial", &check_spatial },
+		{ "timers", &check_timers },
+	};
+}
+
+int run_check(const char* name)
+{
+	for (const auto& check : checks)
+	{
+		if (std::strcmp(check.name, name) != 0)
+			continue;
+
+		const bool ok = check.run();
+		std::printf("%s: %s\n", name, ok ? "passed" : "FAILED");
+		return ok ? 0 : 1;
+	}
+
+	std::printf("unknown check %s\n", name);
+	return 1;
+}
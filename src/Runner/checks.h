@@ -0,0 +1,17 @@
+#pragma once
+
+/**
+ * \brief Runs the self check called name, see main for the list. Prints what it compared
+ * \return Process exit code: 0 if it passed, 1 on a mismatch or an unknown name
+ */
+int run_check(const char* name);
+
+// One per check_*.cpp
+bool check_buffered();
+bool check_heap();
+bool check_logger();
+bool check_metrics();
+bool check_replication();
+bool check_shared();
+bool check_spatial();
+bool check_timers();
@@ -1,16 +1,17 @@
 #include "example_component.h"
-#include <iostream>
+
+#include "logger.h"
 
 ADD_COMPONENT(MyComponent)
 
 void MyComponent::Init()
 {
-	std::cout << "init\n";
+	FEN_LOG_INFO("init");
 }
 
 void MyComponent::Update(const double dt)
 {
-	std::cout << "comp1: updates left: " << counter-- << ", dt: " << dt << " s \n";
+	FEN_LOG_INFO("comp1: updates left: {}, dt: {} s", counter--, dt);
 	
 	if (counter < 0)
 		owner->destroy_component<MyComponent>();
@@ -18,5 +19,5 @@ void MyComponent::Update(const double dt)
 
 void MyComponent::Destroy()
 {
-	std::cout << "destroy\n";
+	FEN_LOG_INFO("destroy");
 }
@@ -1,30 +1,28 @@
 #include "example_component_2.h"
-#include <iostream>
 
 #include "engine.h"
+#include "logger.h"
 
 ADD_COMPONENT(MyComponent_2)
 
-static int times = 5;
-
 void MyComponent_2::Init()
 {
-	std::cout << "init\n";
-	times--;
+	FEN_LOG_INFO("init");
 }
 
 void MyComponent_2::Update(const double dt)
 {
-	std::cout << "comp2: updates left: " << counter-- << ", dt: " << dt << " s \n";
+	FEN_LOG_INFO("comp2: updates left: {}, dt: {} s", counter--, dt);
 
 
 	if (counter < 0)
 	{
-		if (times > 0)
+		if (respawns > 0)
 		{
 			// The entities created from this component are not marked for deletion, but when they destroy themselves, the entity has no component. When there are no entity with a component, they get deleted
-			auto& e = fen::Engine::Instance()->add_entity();
+			auto& e = world().add_entity();
 			e.add_component<MyComponent_2>();
+			e.get_component<MyComponent_2>()->respawns = respawns - 1;
 		}
 
 		owner->destroy_component<MyComponent_2>();
@@ -34,5 +32,5 @@ void MyComponent_2::Update(const double dt)
 
 void MyComponent_2::Destroy()
 {
-	std::cout << "destroy comp2\n";
+	FEN_LOG_INFO("destroy comp2");
 }
@@ -11,4 +11,7 @@ protected:
 
 private:
 	int counter{ 8 };
+
+	// Entities still to create, each from the component created by the previous one
+	int respawns{ 4 };
 };
\ No newline at end of file
@@ -1,11 +1,14 @@
+#include <cstring>
+#include <iostream>
+
+#include "benches.h"
+#include "checks.h"
 #include "engine.h"
 #include "example_component.h"
 
-void create_entities()
+void create_entities(fen::Engine& engine)
 {
-	auto engine = fen::Engine::Instance();
-
-	auto& e = engine->add_entity();
+	auto& e = engine.add_entity();
 	e.set_erase_on_no_components(true);
 
 	// Add a component knowing the type at compilation time. Used when the component is known at compilation time
@@ -18,13 +21,51 @@ void create_entities()
 	e.add_component("MyComponent_22");
 }
 
-int main(void)
+// Tests that the engine can create a component for which it does not know how to make
+void create_unknown_comp(fen::Engine& engine)
 {
-	fen::Engine::CreateInstance();
+	auto& e = engine.add_entity();
+	e.set_erase_on_no_components(true);
+
+	// Add a component that the user 'tells me' that it should exist
+	e.add_component("MyComponent_2");
+
+	// fen does find this component because it isn't created in the user code
+	e.add_component("MyComponent_22");
+}
+
+int main(const int argc, char** argv)
+{
+	// --check name: runs a self check, see checks.cpp. buffered, heap, logger, metrics, replication, shared, spatial, timers
+	if (argc == 3 && std::strcmp(argv[1], "--check") == 0)
+		return run_check(argv[2]);
+
+	// --bench name: runs a benchmark, see benches.cpp. heap
+	if (argc == 3 && std::strcmp(argv[1], "--bench") == 0)
+		return run_bench(argv[2]);
+
+	fen::Engine engine;
+	create_unknown_comp(engine);
+
+	// --replay file: runs a recorded workload with a fixed dt and prints the frame times
+	if (argc == 3 && std::strcmp(argv[1], "--replay") == 0)
+	{
+		fen::WorkloadReplay replay(argv[2]);
+		if (!replay.is_loaded())
+			return 1;
+
+		replay.run(engine);
+		replay.print(std::cout);
+		return 0;
+	}
+
+	// --record file: saves the workload of this run
+	if (argc == 3 && std::strcmp(argv[1], "--record") == 0 && !engine.record_workload(argv[2]))
+		return 1;
 
-	//create_entities();
+	//create_entities(engine);
 
-	fen::Engine::Instance()->run();
+	engine.run();
 
 	return 0;
 }
\ No newline at end of file
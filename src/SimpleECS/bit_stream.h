@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace fen
+{
+
+/**
+ * \brief Appends values of any width up to 64 bits to a byte buffer, least significant bit first
+ */
+class BitWriter
+{
+public:
+
+	explicit BitWriter(std::vector<std::uint8_t>& out_) : out(out_) {}
+
+	void write(const std::uint64_t v, const unsigned bits)
+	{
+		// The accumulator holds less than a byte between writes, so 32 bits always fit
+		if (bits > 32)
+		{
+			put(v & 0xFFFFFFFF, 32);
+			put(v >> 32, bits - 32);
+		}
+		else
+		{
+			put(v, bits);
+		}
+	}
+
+	void write_bit(const bool b) { write(b ? 1 : 0, 1); }
+
+	// 7 bits per group and a continuation bit
+	void write_varint(std::uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			write((v & 0x7F) | 0x80, 8);
+			v >>= 7;
+		}
+		write(v, 8);
+	}
+
+	// Writes the last partial byte
+	void flush()
+	{
+		if (fill > 0)
+			out.push_back(static_cast<std::uint8_t>(acc));
+		acc = 0;
+		fill = 0;
+	}
+
+private:
+
+	void put(const std::uint64_t v, const unsigned bits)
+	{
+		acc |= (v & ((std::uint64_t{ 1 } << bits) - 1)) << fill;
+		fill += bits;
+		for (; fill >= 8; fill -= 8)
+		{
+			out.push_back(static_cast<std::uint8_t>(acc));
+			acc >>= 8;
+		}
+	}
+
+	std::vector<std::uint8_t>& out;
+	std::uint64_t acc{ 0 };
+	unsigned fill{ 0 };
+};
+
+/**
+ * \brief Reads what a BitWriter wrote. Reading past the end returns zeros and sets failed
+ */
+class BitReader
+{
+public:
+
+	BitReader(const std::uint8_t* data_, const std::size_t size_) : data(data_), size(size_) {}
+
+	[[nodiscard]] std::uint64_t read(const unsigned bits)
+	{
+		std::uint64_t v = 0;
+		for (unsigned i = 0; i < bits;)
+		{
+			if (pos >= size * 8)
+			{
+				failed = true;
+				return 0;
+			}
+
+			const unsigned offset = pos % 8;
+			const unsigned n = bits - i < 8 - offset ? bits - i : 8 - offset;
+			const auto chunk = (static_cast<std::uint64_t>(data[pos / 8]) >> offset) & ((1u << n) - 1);
+			v |= chunk << i;
+			i += n;
+			pos += n;
+		}
+		return v;
+	}
+
+	[[nodiscard]] bool read_bit() { return read(1) != 0; }
+
+	[[nodiscard]] std::uint64_t read_varint()
+	{
+		std::uint64_t v = 0;
+		for (unsigned shift = 0; shift < 64; shift += 7)
+		{
+			const auto group = read(8);
+			v |= (group & 0x7F) << shift;
+			if ((group & 0x80) == 0)
+				return v;
+		}
+		failed = true;
+		return 0;
+	}
+
+	[[nodiscard]] bool has_failed() const noexcept { return failed; }
+
+private:
+
+	const std::uint8_t* data;
+	std::size_t size;
+	std::size_t pos{ 0 };
+	bool failed{ false };
+};
+
+} // namespace fen
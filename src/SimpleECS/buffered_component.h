@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include "component.h"
+
+namespace fen
+{
+
+/**
+ * \brief Component whose State is double buffered. During a frame read() returns the state committed at the end of
+ * the previous frame, and write() the state built for the next one, which starts as a copy of it. The buffers swap when
+ * the world frame ends, without touching the components.\n
+ * Buffered components are updated after the others, in parallel when the world has update threads (see
+ * Engine::set_update_threads), so their Update must only read components through read() and write its own state.
+ * Structural changes, sleeping, behaviours, submitted work and mark_changed are not allowed there. A component that
+ * calls write() is marked as changed once the pass is over
+ */
+template<typename State>
+class BufferedComponent : public Component
+{
+public:
+
+	static constexpr bool double_buffered = true;
+
+	BufferedComponent() = default;
+
+	BufferedComponent(BufferedComponent&& other) noexcept : Component(std::move(other)),
+		buffers{ std::move(other.buffers[0]), std::move(other.buffers[1]) }, stamp(other.stamp.load(std::memory_order_relaxed))
+	{
+	}
+
+	/**
+	 * \return The state committed at the end of the previous frame. Safe to call from any buffered Update
+	 */
+	[[nodiscard]] const State& read() const noexcept
+	{
+		const auto s = stamp.load(std::memory_order_acquire);
+		const auto last = static_cast<unsigned>(s & 1);
+
+		// Written this frame: the committed state is the other buffer
+		const auto frame = current_frame();
+		return frame != 0 && (s >> 1) == frame ? buffers[last ^ 1] : buffers[last];
+	}
+
+protected:
+
+	/**
+	 * \return The state of the next frame. The first call of a frame copies the committed state into it
+	 */
+	[[nodiscard]] State& write()
+	{
+		const auto s = stamp.load(std::memory_order_relaxed);
+		const auto frame = current_frame();
+		const auto last = static_cast<unsigned>(s & 1);
+
+		// Before joining a world there is nothing to keep, the state is written in place
+		if (frame == 0 || (s >> 1) == frame)
+			return buffers[last];
+
+		// Readers keep using buffers[last] until the stamp is published
+		buffers[last ^ 1] = buffers[last];
+		stamp.store(frame << 1 | (last ^ 1), std::memory_order_release);
+		written_frame = static_cast<std::uint32_t>(frame);
+		return buffers[last ^ 1];
+	}
+
+private:
+
+	// 0 until the component is initialized. World frames start at 1
+	[[nodiscard]] std::uint64_t current_frame() const noexcept
+	{
+		return get_owner() != nullptr ? world().frame() : 0;
+	}
+
+	State buffers[2]{};
+
+	// Frame of the last write and, in the low bit, the buffer it went to
+	std::atomic<std::uint64_t> stamp{ 0 };
+};
+
+} // namespace fen
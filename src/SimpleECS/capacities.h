@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "component.h"
+#include "component_concepts.h"
+#include "slab_heap.h"
+
+namespace fen
+{
+
+/**
+ * \brief Sizes of a world declared up front. See Engine::reserve
+ */
+struct Capacities
+{
+	// Entities alive at once, counting the ones waiting to be added
+	std::size_t entities{ 0 };
+
+	// Structural operations queued in one frame: entities added or removed, components removed or put to sleep
+	std::size_t pending{ 0 };
+
+	// Components alive at once per type, by Component::Hash. See set
+	std::vector<std::pair<std::uint32_t, std::size_t>> components;
+
+	CapacityPolicy policy{ CapacityPolicy::Assert };
+
+	// Frames run before the heap is sealed, so the engine containers outside the SlabHeap reach their steady size
+	std::uint32_t warmup_frames{ 60 };
+
+	// Locks the reserved memory in RAM
+	bool lock_memory{ false };
+
+	template<concepts::stricly_derived<Component> Comp>
+	Capacities& set(const std::size_t n)
+	{
+		components.emplace_back(Component::Hash<Comp>(), n);
+		return *this;
+	}
+};
+
+} // namespace fen
@@ -0,0 +1,132 @@
+#include "change_tracker.h"
+
+#include <algorithm>
+
+void fen::ChangeTracker::reserve(const std::uint32_t type_id, const std::size_t changed, const std::size_t structural)
+{
+	assert(type_id < pending.size());
+	for (auto set : { &pending[type_id], &current[type_id] })
+	{
+		set->added.reserve(structural);
+		set->changed.reserve(changed);
+		set->removed.reserve(structural);
+	}
+}
+
+void fen::ChangeTracker::on_added(Component* comp)
+{
+	assert(comp->type_id < pending.size());
+	auto& p = pending[comp->type_id];
+	comp->added_frame = frame_;
+	comp->added_slot = static_cast<std::uint32_t>(p.added.size());
+	p.added.push_back(comp);
+}
+
+void fen::ChangeTracker::on_changed(Component* comp)
+{
+	assert(comp->type_id < pending.size());
+
+	// A component added this frame is already reported as added
+	if (comp->changed_frame == frame_ || comp->added_frame == frame_)
+		return;
+
+	auto& p = pending[comp->type_id];
+	comp->changed_frame = frame_;
+	comp->changed_slot = static_cast<std::uint32_t>(p.changed.size());
+	p.changed.push_back(comp);
+}
+
+void fen::ChangeTracker::on_removed(Component* comp, const EntityId owner_id)
+{
+	assert(comp->type_id < pending.size());
+
+	auto& p = pending[comp->type_id];
+	auto& c = current[comp->type_id];
+
+	// Pending entries become holes until the commit, published ones stay nullptr as documented in get
+	if (comp->added_frame == frame_)
+	{
+		assert(p.added[comp->added_slot] == comp);
+		p.added[comp->added_slot] = nullptr;
+		++p.holes;
+	}
+	else if (comp->added_frame + 1 == frame_)
+	{
+		assert(c.added[comp->added_slot] == comp);
+		c.added[comp->added_slot] = nullptr;
+	}
+
+	if (comp->changed_frame == frame_)
+	{
+		assert(p.changed[comp->changed_slot] == comp);
+		p.changed[comp->changed_slot] = nullptr;
+		++p.holes;
+	}
+	else if (comp->changed_frame + 1 == frame_)
+	{
+		assert(c.changed[comp->changed_slot] == comp);
+		c.changed[comp->changed_slot] = nullptr;
+	}
+
+	comp->added_frame = comp->changed_frame = 0;
+	if (!closed)
+		p.removed.push_back(owner_id);
+}
+
+void fen::ChangeTracker::on_relocated(const Component* from, Component* to)
+{
+	assert(to->type_id < pending.size());
+
+	auto& p = pending[to->type_id];
+	auto& c = current[to->type_id];
+
+	// The slots were moved along with the component
+	if (to->added_frame == frame_ || to->added_frame + 1 == frame_)
+	{
+		auto& added = to->added_frame == frame_ ? p.added : c.added;
+		assert(added[to->added_slot] == from);
+		added[to->added_slot] = to;
+	}
+
+	if (to->changed_frame == frame_ || to->changed_frame + 1 == frame_)
+	{
+		auto& changed = to->changed_frame == frame_ ? p.changed : c.changed;
+		assert(changed[to->changed_slot] == from);
+		changed[to->changed_slot] = to;
+	}
+}
+
+void fen::ChangeTracker::commit()
+{
+	for (auto& p : pending)
+	{
+		if (p.holes == 0)
+			continue;
+
+		compact(p.added, &Component::added_slot);
+		compact(p.changed, &Component::changed_slot);
+		p.holes = 0;
+	}
+
+	std::swap(pending, current);
+	for (auto& p : pending)
+		p.clear();
+
+	++frame_;
+}
+
+void fen::ChangeTracker::compact(ComponentSet& v, std::uint32_t Component::* slot)
+{
+	// Order is kept so consumers process deltas in a deterministic order
+	const auto first = std::find(v.begin(), v.end(), nullptr);
+	auto write = static_cast<std::uint32_t>(first - v.begin());
+	for (auto it = first; it != v.end(); ++it)
+	{
+		if (*it == nullptr)
+			continue;
+
+		(*it)->*slot = write;
+		v[write++] = *it;
+	}
+	v.resize(write);
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "component.h"
+#include "component_concepts.h"
+#include "slab_heap.h"
+
+namespace fen
+{
+
+using EntityId = std::uint32_t;
+
+// Group of streamed entities, see StagedRegion
+using RegionId = std::uint32_t;
+constexpr RegionId no_region = 0;
+
+/**
+ * \brief Query filters used with Engine::for_each. They select the components of type Comp that were
+ * added, changed or removed during the previous frame
+ */
+enum class ChangeKind : std::uint8_t { Added, Changed, Removed };
+
+template<concepts::stricly_derived<Component> Comp>
+struct added { using component_type = Comp; static constexpr ChangeKind kind = ChangeKind::Added; };
+
+template<concepts::stricly_derived<Component> Comp>
+struct changed { using component_type = Comp; static constexpr ChangeKind kind = ChangeKind::Changed; };
+
+template<concepts::stricly_derived<Component> Comp>
+struct removed { using component_type = Comp; static constexpr ChangeKind kind = ChangeKind::Removed; };
+
+/**
+ * \brief Records per component type which components were added, changed or removed during a frame.\n
+ * Changes are gathered in a pending set while the frame runs and published with commit() at the end of the frame,
+ * so every consumer sees the same deltas during the next frame regardless of the update order
+ */
+class ChangeTracker
+{
+public:
+
+	using ComponentSet = SlabVector<Component*, MemoryTag::ChangeSets>;
+
+	struct TypeChanges
+	{
+		ComponentSet added;
+		ComponentSet changed;
+		SlabVector<EntityId, MemoryTag::ChangeSets> removed;
+
+		// Entries of added and changed left as nullptr by a removal while pending
+		std::uint32_t holes{ 0 };
+
+		void clear() { added.clear(); changed.clear(); removed.clear(); holes = 0; }
+	};
+
+	/**
+	 * \brief Sets the number of component types that can be tracked
+	 */
+	void resize(const std::size_t num_types)
+	{
+		pending.resize(num_types);
+		current.resize(num_types);
+	}
+
+	/**
+	 * \brief Makes room for the changes of a frame of a component type, so tracking them does not allocate
+	 * \param changed components of the type written in a frame
+	 * \param structural components of the type added or removed in a frame
+	 */
+	void reserve(std::uint32_t type_id, std::size_t changed, std::size_t structural);
+
+	/**
+	 * \brief Called when a component enters the world
+	 */
+	void on_added(Component* comp);
+
+	/**
+	 * \brief Called when a component is written to. A component is only reported once per frame
+	 */
+	void on_changed(Component* comp);
+
+	/**
+	 * \brief Called before a component leaves the world. Clears any reference to it from the change sets in constant
+	 * time, the pending ones are compacted on commit
+	 * \param owner_id entity that owned the component
+	 */
+	void on_removed(Component* comp, EntityId owner_id);
+
+	/**
+	 * \brief Called when a component is moved to another address. Replaces the references to it in the change sets
+	 */
+	void on_relocated(const Component* from, Component* to);
+
+	/**
+	 * \brief Stops recording removals, for a world being destroyed. Its change sets are not read any more, and
+	 * growing them could go over the capacity reserved for a world still running
+	 */
+	void close() noexcept { closed = true; }
+
+	/**
+	 * \brief Publishes the changes of this frame and starts recording the next one
+	 */
+	void commit();
+
+	/**
+	 * \return The changes published on the last commit for the component type. Added and changed entries may be nullptr
+	 * if the component was destroyed after being published
+	 */
+	[[nodiscard]] const TypeChanges& get(const std::uint32_t type_id) const
+	{
+		assert(type_id < current.size());
+		return current[type_id];
+	}
+
+	[[nodiscard]] std::uint32_t frame() const noexcept { return frame_; }
+
+private:
+
+	// Removes the nullptr entries keeping the order, and moves the slots of the components after them
+	static void compact(ComponentSet& v, std::uint32_t Component::* slot);
+
+	std::vector<TypeChanges> pending;
+	std::vector<TypeChanges> current;
+
+	// Starts at 2 so components that were never tracked (frame 0) match neither this frame nor the previous one
+	std::uint32_t frame_{ 2 };
+	bool closed{ false };
+};
+
+} // namespace fen
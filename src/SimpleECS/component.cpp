@@ -1,3 +1,113 @@
 #include "component.h"
 
-std::uint32_t fen::Component::id = 0;
\ No newline at end of file
+#include <cassert>
+#include <cmath>
+
+#include "component_factory.h"
+#include "engine.h"
+#include "entity.h"
+#include "update_pool.h"
+
+fen::Component::~Component()
+{
+	cancel_pending();
+	ComponentFactory::OnComponentFreed(type_id);
+}
+
+void fen::Component::cancel_pending()
+{
+	while (tasks != nullptr)
+		tasks->cancel();
+
+	if (work_head != no_work)
+		owner->world->work.cancel(this);
+}
+
+fen::Engine& fen::Component::world() const
+{
+	assert(owner != nullptr && owner->world != nullptr);
+	return *owner->world;
+}
+
+void fen::Component::mark_changed()
+{
+	assert(!UpdatePool::in_parallel_update() && "The change tracker is not thread safe");
+	++version_;
+
+	// Components that are not yet part of the world are only versioned
+	if (owner != nullptr && owner->world != nullptr)
+		owner->world->changes.on_changed(this);
+}
+
+void fen::Component::sleep_frames(const std::uint32_t frames)
+{
+	assert(owner != nullptr && owner->world != nullptr);
+
+	// The frame wheel is advanced at the start of every frame, so the wake up happens frames + 1 advances later
+	request_sleep(SleepClock::Frames, owner->world->frame_timers.now() + frames + 1);
+}
+
+void fen::Component::sleep_for(const double seconds)
+{
+	assert(owner != nullptr && owner->world != nullptr);
+
+	const auto ms = static_cast<std::uint64_t>(std::ceil(seconds * 1000.0));
+	request_sleep(SleepClock::Time, owner->world->time_timers.now() + ms);
+}
+
+void fen::Component::sleep()
+{
+	assert(owner != nullptr);
+	request_sleep(SleepClock::None, 0);
+}
+
+void fen::Component::wake()
+{
+	if (sleep_state == SleepState::Awake)
+		return;
+
+	assert(owner != nullptr && !UpdatePool::in_parallel_update());
+	owner->wake(this);
+}
+
+void fen::Component::start(Task task)
+{
+	assert(owner != nullptr && owner->world != nullptr && !UpdatePool::in_parallel_update());
+
+	const auto h = std::exchange(task.handle, nullptr);
+	auto& promise = h.promise();
+
+	promise.scheduler = &owner->world->scheduler;
+	promise.comp = this;
+	promise.next = tasks;
+	if (tasks != nullptr)
+		tasks->prev = &promise;
+	tasks = &promise;
+
+	h.resume();
+}
+
+void fen::Component::submit_work(std::function<bool()> step, const int priority)
+{
+	assert(owner != nullptr && owner->world != nullptr && !UpdatePool::in_parallel_update());
+	owner->world->work.submit(std::move(step), priority, this);
+}
+
+void fen::Component::request_sleep(const SleepClock clock, const std::uint64_t deadline)
+{
+	assert(!UpdatePool::in_parallel_update() && "Buffered components can not sleep from their Update");
+
+	sleep_clock = clock;
+	timer.deadline = deadline;
+
+	// The component is moved out of the update list during the purge cycle. A second request replaces the first one
+	if (sleep_state == SleepState::Awake)
+	{
+		sleep_state = SleepState::Requested;
+		owner->comps_to_sleep.push_back(type_id);
+	}
+	else if (sleep_state == SleepState::Sleeping)
+	{
+		owner->schedule(this);
+	}
+}
@@ -2,23 +2,60 @@
 
 #include <cstdint>
 
+#include <functional>
+#include <limits>
 #include <list>
 
+#include "slab_heap.h"
+#include "task.h"
+#include "type_hash.h"
+
 namespace fen
 {
 class Entity;
+class Engine;
+class TimerWheel;
+class Component;
+
+// Update and sleep lists of an entity
+using ComponentList = std::list<Component*, SlabAllocator<Component*, MemoryTag::ComponentLists>>;
+
+namespace detail
+{
+	constexpr std::uint32_t unregistered_type = std::numeric_limits<std::uint32_t>::max();
+
+	// Dense index of a component type, written by ComponentFactory when the type is registered.
+	// Constant initialized, so reading it does not go through a static initialization guard
+	template<typename T>
+	inline std::uint32_t type_index = unregistered_type;
+}
 
 class Component
 {
 friend Entity; // Friend to protect user from calling the engine related functions
+friend class ChangeTracker;
+friend class TimerWheel;
+friend class TaskPromise;
+friend class WorkQueue;
+friend class Defragmenter;
+friend class ComponentCreatorBase;
+friend class Replicator;
+template<typename State> friend class BufferedComponent;
 
 public:
 
-	virtual ~Component() = default;
+	// Cancels the behaviours started by this component
+	virtual ~Component();
 
 	Component() = default;
 	Component(Component&& c) = default;
 
+	// Components live in the SlabHeap, see Defragmenter
+	[[nodiscard]] static void* operator new(const std::size_t size) { return SlabHeap::allocate(size); }
+	static void operator delete(void* ptr, const std::size_t size) noexcept { SlabHeap::deallocate(ptr, size); }
+	[[nodiscard]] static void* operator new(const std::size_t size, const std::align_val_t al) { return ::operator new(size, al); }
+	static void operator delete(void* ptr, const std::size_t, const std::align_val_t al) noexcept { ::operator delete(ptr, al); }
+
 protected:
 
 	/**
@@ -40,23 +77,134 @@ public:
 	 */
 	virtual void Destroy() = 0;
 
+	/**
+	 * \brief Marks this component as changed. Bumps its version and reports it to the engine change sets once per frame
+	 */
+	void mark_changed();
+
+	/**
+	 * \return Number of times this component has been marked as changed
+	 */
+	[[nodiscard]] std::uint32_t version() const noexcept { return version_; }
+
+	[[nodiscard]] Entity* get_owner() const noexcept { return owner; }
+
+	/**
+	 * \return The world this component lives in. Only valid after the component has been initialized
+	 */
+	[[nodiscard]] Engine& world() const;
+
+	/**
+	 * \brief Stops updating this component after the update cycle, skipping the next frames update cycles
+	 * \param frames Number of update cycles skipped
+	 */
+	void sleep_frames(std::uint32_t frames);
+
+	/**
+	 * \brief Stops updating this component after the update cycle until seconds have passed
+	 */
+	void sleep_for(double seconds);
+
+	/**
+	 * \brief Stops updating this component after the update cycle until wake is called
+	 */
+	void sleep();
+
+	/**
+	 * \brief Updates this component again. Cancels any sleep request or timer
+	 */
+	void wake();
+
+	[[nodiscard]] bool is_sleeping() const noexcept { return sleep_state != SleepState::Awake; }
+
+	/**
+	 * \return Dense index of the component type, used to index per type tables. Assigned by ComponentFactory
+	 * sorted by Hash, so it only changes between builds when the set of registered types changes
+	 */
+	template <typename T>
+	static std::uint32_t ID() noexcept
+	{
+		return detail::type_index<T>;
+	}
+
+	/**
+	 * \return Stable identifier of the component type derived from its name. Known at compile time and safe to serialize
+	 */
 	template <typename T>
-	static uint32_t ID() noexcept
+	static constexpr std::uint32_t Hash() noexcept
 	{
-		static uint32_t t_id = id++;
-		return t_id;
+		return type_hash<T>();
 	}
 
 protected:
 
-	void setOwner(Entity* e, const std::list<Component*>::iterator& active_comp_it_) { owner = e; active_comp_it = active_comp_it_; }
+	/**
+	 * \brief Starts a behaviour owned by this component. It runs until its first co_await and is resumed by the engine
+	 * scheduler afterwards. Destroying the component cancels it
+	 */
+	void start(Task task);
+
+	/**
+	 * \brief Submits resumable work run after the update cycle within the engine frame budget. Destroying the component cancels it
+	 * \param step Does a bounded chunk of work. Returns true once the work is finished
+	 * \param priority Higher runs first. Every frame waited counts as one priority point
+	 */
+	void submit_work(std::function<bool()> step, int priority = 0);
+
+	void setOwner(Entity* e, const ComponentList::iterator& active_comp_it_) { owner = e; active_comp_it = active_comp_it_; }
 
 	Entity* owner{ nullptr };
 
 private:
-	std::list<Component*>::iterator active_comp_it{};
+	ComponentList::iterator active_comp_it{};
+
+	std::uint32_t type_id{ 0 };
+	std::uint32_t version_{ 0 };
+
+	// Updated in the buffered pass, see BufferedComponent
+	bool buffered{ false };
+
+	// Last frame a buffered component wrote its next state in, reported to the change tracker after the pass
+	std::uint32_t written_frame{ 0 };
+
+	// Frames in which this component was reported to the change tracker, and its place in those change sets
+	std::uint32_t added_frame{ 0 };
+	std::uint32_t changed_frame{ 0 };
+	std::uint32_t added_slot{ 0 };
+	std::uint32_t changed_slot{ 0 };
+
+	enum class SleepState : std::uint8_t { Awake, Requested, Sleeping };
+	enum class SleepClock : std::uint8_t { None, Frames, Time };
+
+	// Position in the timer wheel while sleeping with a deadline
+	struct TimerNode
+	{
+		TimerWheel* wheel{ nullptr };
+		std::uint64_t deadline{ 0 };
+
+		// Links in the slot list
+		Component* prev{ nullptr };
+		Component* next{ nullptr };
+		std::uint8_t level{ 0 };
+		std::uint8_t slot{ 0 };
+	};
+
+	void request_sleep(SleepClock clock, std::uint64_t deadline);
+
+	// Cancels the behaviours and work of this component. They belong to the world, so this runs on its thread
+	void cancel_pending();
+
+	TimerNode timer;
+
+	// Behaviours started by this component
+	TaskPromise* tasks{ nullptr };
+
+	// First of the jobs submitted by this component still in the work queue. WorkQueue links the rest
+	std::uint32_t work_head{ no_work };
+	static constexpr std::uint32_t no_work = std::numeric_limits<std::uint32_t>::max();
 
-	static uint32_t id;
+	SleepState sleep_state{ SleepState::Awake };
+	SleepClock sleep_clock{ SleepClock::None };
 };
 
 }
\ No newline at end of file
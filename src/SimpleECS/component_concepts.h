@@ -1,7 +1,45 @@
 ﻿#pragma once
 
+#include <concepts>
+#include <functional>
+#include <type_traits>
+
 namespace fen::concepts
 {
 	template<class D, class B>
 	concept stricly_derived = std::is_base_of_v<B, D> && !std::is_same_v<B, D>;
+
+	/**
+	 * \brief A component that declares static constexpr bool relocatable = true. The defragmentation pass may move it
+	 * to another address, so nothing may keep pointers to it across frames
+	 */
+	template<class C>
+	concept relocatable = std::is_move_constructible_v<C> && requires { { C::relocatable } -> std::convertible_to<bool>; } && C::relocatable;
+
+	/**
+	 * \brief A component with double buffered state, see BufferedComponent
+	 */
+	template<class C>
+	concept double_buffered = requires { { C::double_buffered } -> std::convertible_to<bool>; } && C::double_buffered;
+
+	/**
+	 * \brief A component that describes its replicated members with static constexpr auto replicated_fields = fen::layout(...).
+	 * See Replicator
+	 */
+	template<class C>
+	concept replicated = requires { C::replicated_fields; };
+
+	/**
+	 * \brief Data that SharedPool can deduplicate: copyable, compared with == and hashed by std::hash, or without
+	 * padding or floating point members so equal values have equal bytes
+	 */
+	template<class D>
+	concept shareable = std::copy_constructible<D> && std::default_initializable<D> && std::equality_comparable<D> &&
+		(requires(const D& d) { { std::hash<D>{}(d) } -> std::convertible_to<std::size_t>; } || std::has_unique_object_representations_v<D>);
+
+	/**
+	 * \brief A component whose data is shared with the entities that have the same value, see SharedComponent
+	 */
+	template<class C>
+	concept shared = requires { { C::shared } -> std::convertible_to<bool>; } && C::shared;
 }
@@ -3,7 +3,15 @@
 
 
 // Here to prevent including component_factory in the header file
-void fen::ComponentCreatorBase::add_factory(const std::uint32_t& id, const std::size_t str_id, ComponentCreatorBase* creator)
+void fen::ComponentCreatorBase::add_factory()
 {
-	ComponentFactory::GetInstance()->AddFactory(id, str_id, creator);
+	ComponentFactory::GetInstance()->AddFactory(this);
+}
+
+fen::Component* fen::ComponentCreatorBase::adopt(Component* comp)
+{
+	comp->type_id = get_id();
+	comp->buffered = buffered;
+	memory.on_alloc(size);
+	return comp;
 }
@@ -1,43 +1,114 @@
 #pragma once
 
 #include <cstdint>
-#include <string>
+#include <tuple>
 #include <type_traits>
+#include <vector>
 
 #include "component.h"
 
 #include "component_concepts.h"
+#include "field_layout.h"
+#include "memory_stats.h"
 
 namespace fen
 {
 	
 class ComponentCreatorBase
 {
+	friend class ComponentFactory;
+
 public:
-	ComponentCreatorBase() = default;
+	ComponentCreatorBase(const char* name_, const std::uint32_t hash_, std::uint32_t* index_, const std::size_t size_, const bool buffered_)
+		: name(name_), hash(hash_), index(index_), size(size_), buffered(buffered_) {}
 	virtual ~ComponentCreatorBase() = default;
 	virtual Component* operator()() = 0;
-	[[nodiscard]] virtual std::uint32_t get_id() const = 0;
-	void add_factory(const std::uint32_t& id, const std::size_t str_id, ComponentCreatorBase* creator);
+
+	// Moves from to a new allocation. nullptr if the type is not relocatable
+	[[nodiscard]] virtual Component* relocate(Component* from) = 0;
+
+	// Packs the replicated fields of comp, one value per field. Nothing for types without a layout
+	virtual void read_fields(const Component* comp, std::uint64_t* values) const = 0;
+
+	// Unpacks the fields selected by mask, bit i for field i
+	virtual void write_fields(Component* comp, const std::uint64_t* values, std::uint64_t mask) const = 0;
+
+	[[nodiscard]] std::uint32_t get_id() const { return *index; }
+	[[nodiscard]] std::uint32_t get_hash() const { return hash; }
+	[[nodiscard]] const char* get_name() const { return name; }
+	[[nodiscard]] std::size_t get_size() const { return size; }
+	[[nodiscard]] bool is_buffered() const { return buffered; }
+	[[nodiscard]] const std::vector<std::uint8_t>& get_field_bits() const { return field_bits; }
+	[[nodiscard]] const MemoryAccount& get_memory() const { return memory; }
+	void add_factory();
+
+protected:
+
+	// Gives a new component its type id and accounts it
+	Component* adopt(Component* comp);
+
+	// Width of every replicated field, see concepts::replicated
+	std::vector<std::uint8_t> field_bits;
+
+private:
+	const char* name;
+	std::uint32_t hash;
+
+	// Component::ID of the created type, written by the factory
+	std::uint32_t* index;
+
+	std::size_t size;
+	bool buffered;
+
+	// Never freed, components outliving the factory still account themselves to it. See ComponentFactory::OnComponentFreed
+	MemoryAccount& memory{ *new MemoryAccount };
 };
 
 template<concepts::stricly_derived<Component> Comp>
 class ComponentCreator : public ComponentCreatorBase
 {
 public:
-	explicit ComponentCreator(const char* str)
+	explicit ComponentCreator(const char* str) : ComponentCreatorBase(str, Component::Hash<Comp>(), &detail::type_index<Comp>, sizeof(Comp), concepts::double_buffered<Comp>)
 	{
-		add_factory(Component::ID<Comp>(), std::hash<std::string>().operator()(std::string(str)), this);
+		if constexpr (concepts::replicated<Comp>)
+			std::apply([this](const auto&... fields) { (field_bits.push_back(static_cast<std::uint8_t>(fields.bits)), ...); }, Comp::replicated_fields);
+
+		add_factory();
 	}
 
-	[[nodiscard]] std::uint32_t get_id() const override
+	Comp* operator()() override
 	{
-		return Component::ID<Comp>();
+		return static_cast<Comp*>(adopt(new Comp()));
 	}
 
-	Comp* operator()() override
+	Comp* relocate(Component* from) override
+	{
+		if constexpr (concepts::relocatable<Comp>)
+			return static_cast<Comp*>(adopt(new Comp(std::move(*static_cast<Comp*>(from)))));
+		else
+			return nullptr;
+	}
+
+	void read_fields(const Component* comp, std::uint64_t* values) const override
+	{
+		if constexpr (concepts::replicated<Comp>)
+		{
+			const auto& c = *static_cast<const Comp*>(comp);
+			std::apply([&](const auto&... fields) { ((*values++ = fields.encode(c)), ...); }, Comp::replicated_fields);
+		}
+	}
+
+	void write_fields(Component* comp, const std::uint64_t* values, const std::uint64_t mask) const override
 	{
-		return new Comp();
+		if constexpr (concepts::replicated<Comp>)
+		{
+			auto& c = *static_cast<Comp*>(comp);
+			unsigned i = 0;
+			std::apply([&](const auto&... fields)
+			{
+				((((mask >> i) & 1) != 0 ? fields.decode(c, values[i]) : void(), ++i), ...);
+			}, Comp::replicated_fields);
+		}
 	}
 };
 
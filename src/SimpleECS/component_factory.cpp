@@ -1,11 +1,73 @@
 #include "component_factory.h"
 
-#include <iostream>
+#include <algorithm>
+#include <cstdlib>
 
 #include "component_creator.h"
+#include "logger.h"
 
 INIT_INSTANCE_STATIC(fen::ComponentFactory);
 
+namespace
+{
+	struct TypeMemory
+	{
+		std::size_t size;
+		fen::MemoryAccount* account;
+	};
+
+	// By type id. Never destroyed: components may be freed by static destructors or by a reclaimer thread still running at exit
+	std::vector<TypeMemory>& type_memory()
+	{
+		static auto types = new std::vector<TypeMemory>;
+		return *types;
+	}
+}
+
+void fen::ComponentFactory::AddFactory(ComponentCreatorBase* creator)
+{
+	const auto name_hash = fnv1a(creator->get_name());
+	const auto by_name = str_create_funcs.find(name_hash);
+	const auto by_hash = hash_create_funcs.find(creator->get_hash());
+
+	// The rejected type would keep an unregistered id, which indexes past the component tables in every build
+	if (by_name != str_create_funcs.end() || by_hash != hash_create_funcs.end())
+	{
+		const auto other = by_name != str_create_funcs.end() ? by_name->second : by_hash->second;
+		FEN_LOG_ERROR("component {} collides with {}, rename one of them", creator->get_name(), other->get_name());
+		Logger::flush();
+		std::abort();
+	}
+
+	*creator->index = static_cast<std::uint32_t>(id_create_funcs.size());
+	id_create_funcs.push_back(creator);
+	type_memory().push_back({ creator->get_size(), &creator->memory });
+	str_create_funcs.emplace(name_hash, creator);
+	hash_create_funcs.emplace(creator->get_hash(), creator);
+}
+
+void fen::ComponentFactory::SortIds()
+{
+	std::call_once(ids_sorted, [this]
+	{
+		std::sort(id_create_funcs.begin(), id_create_funcs.end(),
+			[](const ComponentCreatorBase* a, const ComponentCreatorBase* b) { return a->get_hash() < b->get_hash(); });
+
+		for (std::uint32_t i = 0; i < id_create_funcs.size(); ++i)
+		{
+			*id_create_funcs[i]->index = i;
+			type_memory()[i] = { id_create_funcs[i]->get_size(), &id_create_funcs[i]->memory };
+		}
+	});
+}
+
+void fen::ComponentFactory::OnComponentFreed(const std::uint32_t c_id) noexcept
+{
+	const auto& types = type_memory();
+	assert(c_id < types.size());
+	types[c_id].account->on_free(types[c_id].size);
+}
+
 fen::Component* fen::ComponentFactory::create_component_Impl(const std::uint32_t id) const
 {
 	return id_create_funcs[id]->operator()();
@@ -13,7 +75,7 @@ fen::Component* fen::ComponentFactory::create_component_Impl(const std::uint32_t
 
 fen::Component* fen::ComponentFactory::create_component_Impl(const char* str, std::uint32_t& c_id) const
 {
-	const auto it = str_create_funcs.find(std::hash<std::string>().operator()(std::string(str)));
+	const auto it = str_create_funcs.find(fnv1a(str));
 
 	// Runtime check instead of assert
 	if(it != str_create_funcs.end())
@@ -23,12 +85,86 @@ fen::Component* fen::ComponentFactory::create_component_Impl(const char* str, st
 	}
 	else
 	{
-		std::cerr << str << " not found!\n";
+		FEN_LOG_WARN("component {} not found", str);
 		c_id = 0;
 		return nullptr;
 	}
 }
 
+fen::Component* fen::ComponentFactory::RelocateComponent(const std::uint32_t c_id, Component* from) const
+{
+	assert(c_id < id_create_funcs.size());
+	return id_create_funcs[c_id]->relocate(from);
+}
+
+const char* fen::ComponentFactory::GetName(const std::uint32_t id) const
+{
+	assert(id < id_create_funcs.size());
+	return id_create_funcs[id]->get_name();
+}
+
+bool fen::ComponentFactory::GetId(const char* str, std::uint32_t& c_id) const
+{
+	const auto it = str_create_funcs.find(fnv1a(str));
+	if (it == str_create_funcs.end())
+		return false;
+
+	c_id = it->second->get_id();
+	return true;
+}
+
+bool fen::ComponentFactory::GetIdFromHash(const std::uint32_t hash, std::uint32_t& c_id) const
+{
+	const auto it = hash_create_funcs.find(hash);
+	if (it == hash_create_funcs.end())
+		return false;
+
+	c_id = it->second->get_id();
+	return true;
+}
+
+std::size_t fen::ComponentFactory::GetSize(const std::uint32_t id) const
+{
+	assert(id < id_create_funcs.size());
+	return id_create_funcs[id]->get_size();
+}
+
+std::uint32_t fen::ComponentFactory::GetHash(const std::uint32_t id) const
+{
+	assert(id < id_create_funcs.size());
+	return id_create_funcs[id]->get_hash();
+}
+
+bool fen::ComponentFactory::IsBuffered(const std::uint32_t id) const
+{
+	assert(id < id_create_funcs.size());
+	return id_create_funcs[id]->is_buffered();
+}
+
+const std::vector<std::uint8_t>& fen::ComponentFactory::GetFieldBits(const std::uint32_t id) const
+{
+	assert(id < id_create_funcs.size());
+	return id_create_funcs[id]->get_field_bits();
+}
+
+void fen::ComponentFactory::ReadFields(const std::uint32_t id, const Component* comp, std::uint64_t* values) const
+{
+	assert(id < id_create_funcs.size());
+	id_create_funcs[id]->read_fields(comp, values);
+}
+
+void fen::ComponentFactory::WriteFields(const std::uint32_t id, Component* comp, const std::uint64_t* values, const std::uint64_t mask) const
+{
+	assert(id < id_create_funcs.size());
+	id_create_funcs[id]->write_fields(comp, values, mask);
+}
+
+const fen::MemoryAccount& fen::ComponentFactory::GetMemory(const std::uint32_t id) const
+{
+	assert(id < id_create_funcs.size());
+	return id_create_funcs[id]->get_memory();
+}
+
 fen::ComponentFactory::~ComponentFactory()
 {
 	for (const auto& c : id_create_funcs)
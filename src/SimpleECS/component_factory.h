@@ -1,11 +1,13 @@
 #pragma once
 
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
 #include "singleton.h"
 #include "component.h"
 #include "component_concepts.h"
+#include "memory_stats.h"
 
 namespace fen
 {
@@ -14,17 +16,26 @@ class ComponentFactory: public Singleton<ComponentFactory>
 	friend Singleton;
 	friend class Engine;
 	friend class ComponentCreatorBase;
+	friend class Component;
 
 protected:
 
-	void AddFactory(const std::uint32_t comp_id, const std::size_t str_id, ComponentCreatorBase* creator)
-	{
-		// assert that it has never been added before
-		assert(id_create_funcs.size() == comp_id);
-		(void(comp_id));
-		id_create_funcs.push_back(creator);
-		str_create_funcs.insert(std::make_pair(str_id, creator));
-	}
+	/**
+	 * \brief Registers a component type and gives it the next free id. Aborts when its name or type hash is already taken
+	 */
+	void AddFactory(ComponentCreatorBase* creator);
+
+	/**
+	 * \brief Reassigns the ids sorted by type hash, so they do not depend on the static initialization order.
+	 * Runs once, before the first engine sizes its per type tables. Types registered later get the next free id
+	 */
+	void SortIds();
+
+	/**
+	 * \brief Accounts a component of type c_id being freed. Called by the Component destructor, which may run after the
+	 * factory is destroyed, so it only reads a table that is never destroyed
+	 */
+	static void OnComponentFreed(std::uint32_t c_id) noexcept;
 
 public:
 
@@ -49,6 +60,12 @@ public:
 		return create_component_Impl(str, c_id);
 	}
 
+	/**
+	 * \brief Move constructs a component of type c_id into a new allocation. from is left moved from, not deleted
+	 * \return nullptr if the component type is not relocatable (see concepts::relocatable)
+	 */
+	[[nodiscard]] Component* RelocateComponent(std::uint32_t c_id, Component* from) const;
+
 private:
 
 	[[nodiscard]] Component* create_component_Impl(const std::uint32_t id) const;
@@ -57,7 +74,9 @@ private:
 protected:
 	
 	std::vector<ComponentCreatorBase*> id_create_funcs;
-	std::unordered_map<std::size_t, ComponentCreatorBase*> str_create_funcs;
+	std::unordered_map<std::uint32_t, ComponentCreatorBase*> str_create_funcs;
+	std::unordered_map<std::uint32_t, ComponentCreatorBase*> hash_create_funcs;
+	std::once_flag ids_sorted;
 public:
 
 	virtual ~ComponentFactory() override;
@@ -90,6 +109,58 @@ public:
 	 * \return number of generated components
 	 */
 	[[nodiscard]] size_t GetNumComps() const { return id_create_funcs.size(); }
+
+	/**
+	 * \return The name the component type was registered with
+	 */
+	[[nodiscard]] const char* GetName(const std::uint32_t id) const;
+
+	/**
+	 * \brief Finds the id of a component type from its name
+	 * \return false if no component type was registered with that name
+	 */
+	[[nodiscard]] bool GetId(const char* str, std::uint32_t& c_id) const;
+
+	/**
+	 * \brief Finds the id of a component type from its Component::Hash. Used to read saved data
+	 * \return false if no component type has that hash
+	 */
+	[[nodiscard]] bool GetIdFromHash(std::uint32_t hash, std::uint32_t& c_id) const;
+
+	/**
+	 * \return The Component::Hash of the component type
+	 */
+	[[nodiscard]] std::uint32_t GetHash(std::uint32_t id) const;
+
+	/**
+	 * \return sizeof the component type
+	 */
+	[[nodiscard]] std::size_t GetSize(std::uint32_t id) const;
+
+	/**
+	 * \return Whether the component type is double buffered, see BufferedComponent
+	 */
+	[[nodiscard]] bool IsBuffered(std::uint32_t id) const;
+
+	/**
+	 * \return Width in bits of every replicated field of the component type. Empty if it has no layout, see concepts::replicated
+	 */
+	[[nodiscard]] const std::vector<std::uint8_t>& GetFieldBits(std::uint32_t id) const;
+
+	/**
+	 * \brief Packs the replicated fields of comp, of type id, into values. One value per entry of GetFieldBits
+	 */
+	void ReadFields(std::uint32_t id, const Component* comp, std::uint64_t* values) const;
+
+	/**
+	 * \brief Unpacks into comp, of type id, the fields selected by mask. Bit i of mask selects values[i]
+	 */
+	void WriteFields(std::uint32_t id, Component* comp, const std::uint64_t* values, std::uint64_t mask) const;
+
+	/**
+	 * \return Live and peak memory of the components of type id, across every world
+	 */
+	[[nodiscard]] const MemoryAccount& GetMemory(std::uint32_t id) const;
 };
 
 } // namespace fen
\ No newline at end of file
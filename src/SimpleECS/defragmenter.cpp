@@ -0,0 +1,189 @@
+#include "defragmenter.h"
+
+#include <chrono>
+#include <optional>
+
+#include "component_factory.h"
+#include "engine.h"
+#include "slab_heap.h"
+
+fen::Defragmenter::Defragmenter(Engine& world_, const double threshold_) : world(world_), threshold(threshold_)
+{
+}
+
+void fen::Defragmenter::run(const double budget)
+{
+	using hr_clock = std::chrono::high_resolution_clock;
+
+	if (phase == Phase::Idle)
+	{
+		if (++idle_frames < measure_interval)
+			return;
+		start(Phase::Measure);
+	}
+
+	// Reading the clock for every entity would cost as much as measuring it
+	const unsigned check_mask = phase == Phase::Measure ? 63 : 7;
+	const auto start_time = hr_clock::now();
+	unsigned n = 0;
+
+	// Relocated objects fill fresh slabs in update order
+	std::optional<SlabHeap::Evacuation> evacuation;
+	if (phase == Phase::Compact)
+		evacuation.emplace();
+
+	const auto end = world.entities.end();
+	while (cursor != end)
+	{
+		if ((++n & check_mask) == 0 && std::chrono::duration<double>(hr_clock::now() - start_time).count() >= budget)
+			return;
+
+		if (phase == Phase::Measure)
+		{
+			measure(*cursor);
+			++cursor;
+		}
+		else
+		{
+			const auto it = cursor++;
+			relocate(it);
+		}
+	}
+
+	if (phase == Phase::Measure)
+		finish_measure();
+	else
+		finish_compact();
+}
+
+void fen::Defragmenter::on_remove(const EntityList::iterator it)
+{
+	if (phase != Phase::Idle && cursor == it)
+		++cursor;
+}
+
+void fen::Defragmenter::start(const Phase phase_)
+{
+	phase = phase_;
+	cursor = world.entities.begin();
+	idle_frames = 0;
+	visits = 0;
+	jumps = 0;
+	last.assign(ComponentFactory::Instance()->GetNumComps() + 1, 0);
+}
+
+void fen::Defragmenter::finish_measure()
+{
+	fragmentation = visits > 0 ? static_cast<double>(jumps) / static_cast<double>(visits) : 0.0;
+
+	const auto ppm = static_cast<std::int64_t>(fragmentation * 1e6);
+	world.metrics.fragmentation.set(ppm);
+
+	if (after_compact)
+	{
+		world.metrics.fragmentation_after.set(ppm);
+		after_compact = false;
+		phase = Phase::Idle;
+	}
+	else if (fragmentation > threshold)
+	{
+		world.metrics.fragmentation_before.set(ppm);
+		start(Phase::Compact);
+	}
+	else
+	{
+		phase = Phase::Idle;
+	}
+}
+
+void fen::Defragmenter::finish_compact()
+{
+	// Measure again to report the result
+	after_compact = true;
+	start(Phase::Measure);
+}
+
+void fen::Defragmenter::measure(const Entity& e)
+{
+	visit(0, &e);
+	for (const auto comp : e.active_comps)
+		visit(comp->type_id + 1, comp);
+}
+
+void fen::Defragmenter::visit(const std::size_t stream, const void* p)
+{
+	const auto addr = reinterpret_cast<std::uintptr_t>(p);
+	if (last[stream] != 0)
+	{
+		++visits;
+		if (addr < last[stream] || addr - last[stream] > max_jump)
+			++jumps;
+	}
+	last[stream] = addr;
+}
+
+void fen::Defragmenter::relocate(const EntityList::iterator it)
+{
+	auto& entities = world.entities;
+	auto& o = *it;
+
+	// Allocated in update order: the entity node and its table, then a list node and the component for each component
+	const auto n_it = entities.emplace(it, o.id, o.world);
+	auto& n = *n_it;
+
+	n.initialized = o.initialized;
+	n.erase = o.erase;
+	n.erase_on_no_components = o.erase_on_no_components;
+	n.comps = o.comps;
+	n.comps_to_remove = std::move(o.comps_to_remove);
+	n.comps_to_sleep = std::move(o.comps_to_sleep);
+	n.comps_to_init = std::move(o.comps_to_init);
+
+	for (const auto comp : o.active_comps)
+	{
+		const auto c = relocate(comp);
+		n.active_comps.push_back(c);
+		c->setOwner(&n, std::prev(n.active_comps.end()));
+		n.comps[c->type_id] = c;
+	}
+
+	// Sleeping components are referenced by the timer wheels, only their list node moves
+	for (const auto comp : o.sleeping_comps)
+	{
+		n.sleeping_comps.push_back(comp);
+		comp->setOwner(&n, std::prev(n.sleeping_comps.end()));
+	}
+
+	if (o.region != no_region)
+	{
+		n.region = o.region;
+		n.region_it = o.region_it;
+		*n.region_it = n_it;
+	}
+
+	// The old entity keeps no component, its destructor only frees its own memory. Freeing it right away is safe,
+	// the evacuation does not reuse the holes
+	o.active_comps.clear();
+	o.sleeping_comps.clear();
+	o.moved = true;
+	entities.erase(it);
+
+	world.metrics.relocated_entities.add();
+}
+
+fen::Component* fen::Defragmenter::relocate(Component* comp)
+{
+	// Behaviours, jobs and timers keep pointers to the component
+	if (comp->tasks != nullptr || comp->work_head != Component::no_work || comp->sleep_state != Component::SleepState::Awake)
+		return comp;
+
+	const auto moved = ComponentFactory::Instance()->RelocateComponent(comp->type_id, comp);
+	if (moved == nullptr)
+		return comp;
+
+	world.changes.on_relocated(comp, moved);
+	delete comp;
+
+	world.metrics.relocated_components.add();
+	return moved;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+#include "entity.h"
+
+namespace fen
+{
+class Component;
+class Engine;
+
+/**
+ * \brief Incremental pass restoring the locality of a world after churn. It walks the entities in update order measuring
+ * how often an entity, or a component, is not right after the previous one of its kind in memory. Over the threshold,
+ * it rebuilds every entity, its component table and lists, and its relocatable components (see concepts::relocatable)
+ * under a SlabHeap::Evacuation, so they are laid out again in update order and the slabs they leave are released.\n
+ * Work is split across frames by a time budget. Pointers to entities are not stable while it runs
+ */
+class Defragmenter
+{
+public:
+
+	/**
+	 * \param threshold_ fraction of jumps (see get_fragmentation) that starts a compaction
+	 */
+	Defragmenter(Engine& world_, double threshold_ = 0.25);
+
+	Defragmenter(const Defragmenter& other) = delete;
+	Defragmenter& operator=(const Defragmenter& other) = delete;
+
+	/**
+	 * \brief Measures or compacts until budget seconds are spent
+	 */
+	void run(double budget);
+
+	/**
+	 * \brief Keeps the pass position valid. Called before an entity leaves the world list
+	 */
+	void on_remove(EntityList::iterator it);
+
+	void set_threshold(const double threshold_) noexcept { threshold = threshold_; }
+
+	/**
+	 * \return Last measured fraction of steps, from an entity to the next one and from a component to the next one of
+	 * its type, that jump backwards or further than max_jump bytes
+	 */
+	[[nodiscard]] double get_fragmentation() const noexcept { return fragmentation; }
+
+	static constexpr std::uintptr_t max_jump = 1024;
+
+	// Frames between two measures while the world is not fragmented
+	static constexpr std::uint32_t measure_interval = 300;
+
+private:
+
+	enum class Phase : std::uint8_t { Idle, Measure, Compact };
+
+	void start(Phase phase_);
+	void finish_measure();
+	void finish_compact();
+
+	void measure(const Entity& e);
+
+	// Steps from the last address of a stream: stream 0 is the entities, then one per component type
+	void visit(std::size_t stream, const void* p);
+
+	// Rebuilds the entity before it and frees the old one
+	void relocate(EntityList::iterator it);
+	[[nodiscard]] Component* relocate(Component* comp);
+
+	Engine& world;
+	double threshold;
+	double fragmentation{ 0.0 };
+
+	Phase phase{ Phase::Idle };
+	bool after_compact{ false };
+	std::uint32_t idle_frames{ 0 };
+	EntityList::iterator cursor;
+
+	std::uint64_t visits{ 0 };
+	std::uint64_t jumps{ 0 };
+	std::vector<std::uintptr_t> last;
+};
+
+} // namespace fen
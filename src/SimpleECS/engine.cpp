@@ -1,23 +1,99 @@
 #include "engine.h"
+#include <algorithm>
 #include <chrono>
+#include <iterator>
+#include <limits>
 
 #include "component_factory.h"
+#include "replication.h"
 
-INIT_INSTANCE_STATIC(fen::Engine);
+fen::Engine::Engine() : metrics(ComponentFactory::Instance()->GetNumComps())
+{
+	ComponentFactory::Instance()->SortIds();
+
+	changes.resize(ComponentFactory::Instance()->GetNumComps());
+	profiler.resize_types(ComponentFactory::Instance()->GetNumComps());
+
+	for (std::uint32_t id = 0; id < ComponentFactory::Instance()->GetNumComps(); ++id)
+	{
+		if (ComponentFactory::Instance()->IsBuffered(id))
+			buffered_types.push_back(id);
+	}
+}
 
 fen::Engine::~Engine()
 {
+	if (sealed_heap)
+		SlabHeap::unseal();
+	if (retains_slabs)
+		SlabHeap::release_empty_slabs();
+
+	if (metrics_registry != nullptr)
+		metrics_registry->detach(this);
+
+	if (replicator != nullptr)
+		replicator->world = nullptr;
+
+	// Freed in place from here on
+	if (reclaimer != nullptr)
+		reclaimer->submit(std::move(graveyard));
+	reclaimer = nullptr;
+
+	changes.close();
 	for(auto& e : entities)
 	{
-		e.Destroy();
+		e.release();
 	}
 }
 
 void fen::Engine::run()
 {
-	profiler.start_timing<Steps_Enum::Init>();
+	init();
+
+	while(step()) {}
+
+	print_times();
+}
+
+void fen::Engine::set_update_threads(const unsigned n)
+{
+	update_pool = n > 0 ? std::make_unique<UpdatePool>(n) : nullptr;
+}
+
+void fen::Engine::update_buffered(const double dt)
+{
+	const bool any = std::any_of(buffered_types.begin(), buffered_types.end(),
+		[this](const std::uint32_t id) { return metrics.components[id].get() > 0; });
+	if (!any)
+		return;
 
-	test_create_unknown_comp();
+	if (update_pool == nullptr)
+	{
+		for (auto& e : entities)
+		{
+			e.update_buffered(dt);
+			e.report_buffered_writes();
+		}
+		return;
+	}
+
+	// Only components are touched, the entity list stays as it is until the purge cycle
+	auto update_chunk = [this, dt](const std::size_t i)
+	{
+		const auto end = i + 1 < update_chunks.size() ? update_chunks[i + 1] : entities.end();
+		for (auto it = update_chunks[i]; it != end; ++it)
+			it->update_buffered(dt);
+	};
+	update_pool->run(update_chunks.size(), update_chunk);
+
+	// The change tracker is not thread safe, the writes are reported once the threads are done
+	for (auto& e : entities)
+		e.report_buffered_writes();
+}
+
+void fen::Engine::init()
+{
+	profiler.start_timing<Steps_Enum::Init>();
 
 	// Initialize starting entities
 	while(!entities_to_add.empty())
@@ -27,87 +103,379 @@ void fen::Engine::run()
 		entities.back().init();
 	}
 
-	// For delta time calculation
-	using hr_clock = std::chrono::high_resolution_clock;
-	auto t_start = hr_clock::now();
-	double dt;
-	bool some_comps;
+	if (recorder != nullptr)
+		recorder->init();
+
+	t_start = std::chrono::high_resolution_clock::now();
 
 	profiler.finish_timing<Steps_Enum::Init>();
+}
 
-	while(!exit_)
-	{
-		profiler.start_timing<Steps_Enum::Update>();
+bool fen::Engine::step()
+{
+	using hr_clock = std::chrono::high_resolution_clock;
 
-		dt = std::chrono::duration<double>(hr_clock::now() - t_start).count();
-		t_start = hr_clock::now();
+	if (exit_)
+		return false;
 
-		// Update cycle
-		for (auto& e : entities)
+	profiler.start_timing<Steps_Enum::Update>();
+
+	const auto structural_start = metrics.structural_changes.get();
+
+	const double dt = fixed_dt > 0.0 ? fixed_dt : std::chrono::duration<double>(hr_clock::now() - t_start).count();
+	t_start = hr_clock::now();
+
+	wake_timers(dt);
+
+	// Update cycle
+	update_chunks.clear();
+	std::size_t chunk_fill = 0;
+	for (auto it = entities.begin(); it != entities.end(); ++it)
+	{
+		if (update_pool != nullptr && chunk_fill-- == 0)
 		{
-			e.update(dt);
+			update_chunks.push_back(it);
+			chunk_fill = update_chunk_size - 1;
 		}
+		it->update(dt);
+	}
 
-		profiler.finish_timing<Steps_Enum::Update>();
+	update_buffered(dt);
 
-		profiler.start_timing<Steps_Enum::Purge>();
+	// Resume the behaviours that are ready
+	scheduler.run(elapsed_time);
 
-		some_comps = false;
+	// Spend what is left of the budget on the submitted work
+	work.run(work_budget, changes.frame());
 
-		// purge components
-		for(auto it = entities.begin(); it != entities.end(); ++it)
-		{
-			it->purge();
-			if(it->erase)
-				entities_to_remove.emplace(it);
+	profiler.finish_timing<Steps_Enum::Update>();
+
+	profiler.start_timing<Steps_Enum::Purge>();
+
+	bool some_comps = false;
+
+	metrics.pending_adds.set(static_cast<std::int64_t>(entities_to_add.size()));
 
+	// purge components
+	for(auto it = entities.begin(); it != entities.end(); ++it)
+	{
+		it->purge();
+		if(it->erase)
+			entities_to_remove.emplace(it);
+		else
 			some_comps = some_comps || !it->has_no_components();
+	}
+
+	metrics.pending_removes.set(static_cast<std::int64_t>(entities_to_remove.size()));
+	metrics.structural_changes.add(entities_to_remove.size() + entities_to_add.size());
+
+	// purge entities
+	while (!entities_to_remove.empty())
+	{
+		remove_entity(entities_to_remove.front());
+		entities_to_remove.pop();
+	}
+
+	// add and initialize created entities
+	while (!entities_to_add.empty())
+	{
+		// Destroyed before being added
+		if (entities_to_add.front().erase)
+		{
+			entities_to_add.pop();
+			continue;
 		}
 
-		// purge entities
-		while (!entities_to_remove.empty())
+		entities.emplace_back(std::move(entities_to_add.front()));
+		entities_to_add.pop();
+		entities.back().init();
+
+		some_comps = some_comps || !entities.back().has_no_components();
+	}
+
+	while (!ignored_entities.empty())
+		ignored_entities.pop();
+
+	profiler.finish_timing<Steps_Enum::Purge>();
+
+	profiler.start_timing<Steps_Enum::Stream>();
+
+	const auto streamed_start = entities.size();
+	const bool streaming = stream(streaming_budget);
+	some_comps = some_comps || entities.size() > streamed_start;
+
+	profiler.finish_timing<Steps_Enum::Stream>();
+
+	if (defrag_budget > 0.0)
+	{
+		profiler.start_timing<Steps_Enum::Defrag>();
+		defrag.run(defrag_budget);
+		profiler.finish_timing<Steps_Enum::Defrag>();
+	}
+
+	// Blocks if the reclaimer is behind
+	if (reclaimer != nullptr && !graveyard.empty())
+		reclaimer->submit(std::move(graveyard));
+
+	// Publish this frame's changes for the next update cycle
+	changes.commit();
+	spatial.update(changes);
+
+	if (replicator != nullptr)
+		replicator->capture();
+
+	// If user marked exit, or there are no entities left, or there are no components in any entity, stop execution.
+	// A world still streaming entities in keeps running
+	exit_ = exit_ || ((entities.empty() || !some_comps) && !streaming);
+
+	profiler.next_step();
+
+	const auto tick_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(hr_clock::now() - t_start).count();
+	metrics.entities.set(static_cast<std::int64_t>(entities.size()));
+	metrics.structural_changes_frame.set(static_cast<std::int64_t>(metrics.structural_changes.get() - structural_start));
+	metrics.tick_time_ns.set(tick_ns);
+	metrics.tick_time_ns_total.add(static_cast<std::uint64_t>(tick_ns));
+	metrics.frames.add();
+	metrics.work_items.set(static_cast<std::int64_t>(work.size()));
+
+	if (recorder != nullptr)
+		recorder->frame(dt);
+
+	if (seal_pending && changes.frame() >= seal_frame)
+	{
+		if (!sealed_heap)
+			SlabHeap::seal(seal_policy);
+		seal_pending = false;
+		sealed_heap = true;
+	}
+
+	return !exit_;
+}
+
+void fen::Engine::reserve(const Capacities& capacities)
+{
+	SlabHeap::set_lock_memory(capacities.lock_memory);
+	if (!retains_slabs)
+		SlabHeap::retain_empty_slabs();
+	retains_slabs = true;
+
+	const auto factory = ComponentFactory::Instance();
+	std::size_t num_comps = 0;
+	for (const auto& [hash, n] : capacities.components)
+	{
+		std::uint32_t c_id;
+		if (!factory->GetIdFromHash(hash, c_id))
+			continue;
+
+		SlabHeap::reserve(factory->GetSize(c_id), n);
+		changes.reserve(c_id, n, capacities.pending);
+		num_comps += n;
+	}
+
+	// Every component may wake up in the same frame
+	woken_comps.reserve(num_comps);
+
+	// Node and block sizes are up to the standard library, so the containers reserve their size classes by being
+	// filled and emptied. The empty slabs stay as spares
+	{
+		EntityList list;
+		for (std::size_t i = 0; i < capacities.entities; ++i)
+			list.emplace_back(0, this);
+
+		Queue<Entity> adds;
+		Queue<EntityList::iterator> removes;
+		for (auto it = list.begin(); it != list.end() && adds.size() < capacities.pending; ++it)
 		{
-			auto& e = entities_to_remove.front();
-			e->Destroy();
-			entities.erase(e);
-			entities_to_remove.pop();
+			adds.emplace(std::move(*it));
+			removes.push(it);
 		}
 
-		// add and initialize created entities
-		while (!entities_to_add.empty())
+		ComponentList comps(num_comps, nullptr);
+		std::list<std::uint32_t, SlabAllocator<std::uint32_t, MemoryTag::Queues>> ops(capacities.pending, 0);
+	}
+
+	seal_policy = capacities.policy;
+	seal_frame = frame() + capacities.warmup_frames;
+	seal_pending = true;
+}
+
+void fen::Engine::register_metrics(MetricsRegistry& registry, const std::string& world_name)
+{
+	assert(metrics_registry == nullptr);
+	metrics_registry = &registry;
+
+	const auto world = "world=\"" + world_name + "\"";
+
+	registry.attach(this, metrics.entities, "fen_entities", "Entities in the world", world);
+	registry.attach(this, metrics.pending_adds, "fen_pending_entity_adds", "Entities added during the last update cycle", world);
+	registry.attach(this, metrics.pending_removes, "fen_pending_entity_removes", "Entities removed during the last purge cycle", world);
+	registry.attach(this, metrics.structural_changes, "fen_structural_changes_total", "Entities and components added or removed", world);
+	registry.attach(this, metrics.structural_changes_frame, "fen_structural_changes_frame", "Entities and components added or removed during the last frame", world);
+	registry.attach(this, metrics.staged_entities, "fen_staged_entities", "Streamed entities waiting to be committed", world);
+	registry.attach(this, metrics.streamed_in, "fen_streamed_in_total", "Streamed entities committed to the world", world);
+	registry.attach(this, metrics.streamed_out, "fen_streamed_out_total", "Streamed entities removed by unloading their region", world);
+	registry.attach(this, metrics.fragmentation, "fen_fragmentation", "Fraction of update steps that jump in memory, last measure", world, 1e-6);
+	registry.attach(this, metrics.fragmentation_before, "fen_fragmentation_before_compaction", "Fragmentation that started the last compaction", world, 1e-6);
+	registry.attach(this, metrics.fragmentation_after, "fen_fragmentation_after_compaction", "Fragmentation measured after the last compaction", world, 1e-6);
+	registry.attach(this, metrics.relocated_entities, "fen_relocated_entities_total", "Entities rebuilt by the defragmentation pass", world);
+	registry.attach(this, metrics.relocated_components, "fen_relocated_components_total", "Components moved by the defragmentation pass", world);
+	registry.attach(this, metrics.work_items, "fen_work_items", "Budgeted work items waiting to finish", world);
+	registry.attach(this, metrics.frames, "fen_frames_total", "Update and purge cycles run", world);
+	registry.attach(this, metrics.tick_time_ns, "fen_tick_seconds", "Duration of the last update and purge cycle", world, 1e-9);
+	registry.attach(this, metrics.tick_time_ns_total, "fen_tick_seconds_total", "Time spent on update and purge cycles", world, 1e-9);
+
+	const auto factory = ComponentFactory::Instance();
+	for (std::uint32_t i = 0; i < metrics.components.size(); ++i)
+	{
+		registry.attach(this, metrics.components[i], "fen_components", "Components in the world per type",
+			world + ",type=\"" + factory->GetName(i) + "\"");
+	}
+}
+
+void fen::Engine::stage(StagedRegion&& region)
+{
+	assert(region.world == this);
+
+	std::lock_guard lock(staging_mutex);
+	staged.push_back(std::move(region));
+}
+
+void fen::Engine::unload_region(const RegionId region)
+{
+	const auto drop = [region](const StagedRegion& r) { return r.region == region; };
+	{
+		std::lock_guard lock(staging_mutex);
+		std::erase_if(staged, drop);
+	}
+	std::erase_if(committing, drop);
+
+	regions_to_unload.push_back(region);
+}
+
+bool fen::Engine::stream(const double budget)
+{
+	using hr_clock = std::chrono::high_resolution_clock;
+
+	{
+		std::lock_guard lock(staging_mutex);
+		std::move(staged.begin(), staged.end(), std::back_inserter(committing));
+		staged.clear();
+	}
+
+	const auto start = hr_clock::now();
+	const auto in_budget = [&start, budget] { return std::chrono::duration<double>(hr_clock::now() - start).count() < budget; };
+
+	// Unloading first gives the memory back before loading more
+	bool first = true;
+	while (!regions_to_unload.empty() && (first || in_budget()))
+	{
+		const auto region = regions.find(regions_to_unload.front());
+		if (region == regions.end() || region->second.empty())
 		{
-			entities.emplace_back(std::move(entities_to_add.front()));
-			entities_to_add.pop();
-			entities.back().init();
+			if (region != regions.end())
+				regions.erase(region);
+			regions_to_unload.pop_front();
+			continue;
+		}
+
+		const auto e = region->second.front();
+		e->record(WorkloadOp::DestroyEntity);
+		remove_entity(e);
 
-			some_comps = some_comps || !entities.back().has_no_components();
+		metrics.streamed_out.add();
+		first = false;
+	}
+
+	first = true;
+	std::int64_t num_staged = 0;
+	while (!committing.empty() && (first || in_budget()))
+	{
+		auto& batch = committing.front().entities;
+		if (batch.empty())
+		{
+			committing.pop_front();
+			continue;
+		}
+
+		// Destroyed while staged
+		if (batch.front().erase)
+		{
+			batch.pop_front();
+			continue;
 		}
 
-		profiler.finish_timing<Steps_Enum::Purge>();
+		auto& e = entities.emplace_back(std::move(batch.front()));
+		batch.pop_front();
 
-		// If user marked exit, or there are no entities left, or there are no components in any entity, stop execution
-		exit_ = exit_ || entities.empty() || !some_comps;
+		e.id = next_entity_id++;
+		e.staged = false;
+		if (recorder != nullptr)
+			e.record_created();
 
-		profiler.next_step();
+		auto& members = regions[committing.front().region];
+		e.region = committing.front().region;
+		e.region_it = members.insert(members.end(), std::prev(entities.end()));
+
+		e.init();
+
+		metrics.streamed_in.add();
+		metrics.structural_changes.add();
+		first = false;
 	}
 
-	printf("Time spent on Init: %.3f %s\n", profiler.get_time<Steps_Enum::Init>(), profiler.unit());
-	printf("Avg Time spent on Update: %.3f %s\n", profiler.get_avg_time<Steps_Enum::Update>(), profiler.unit());
-	printf("Avg Time spent on Purge: %.3f %s\n", profiler.get_avg_time<Steps_Enum::Purge>(), profiler.unit());
+	for (const auto& r : committing)
+		num_staged += static_cast<std::int64_t>(r.entities.size());
+	metrics.staged_entities.set(num_staged);
+
+	return !committing.empty() || !regions_to_unload.empty();
+}
+
+void fen::Engine::remove_entity(const EntityList::iterator it)
+{
+	defrag.on_remove(it);
+
+	if (it->region != no_region)
+		regions[it->region].erase(it->region_it);
+
+	it->release();
+
+	if (reclaimer != nullptr)
+		graveyard.entities.splice(graveyard.entities.end(), entities, it);
+	else
+		entities.erase(it);
 }
 
-void fen::Engine::test_create_unknown_comp()
+bool fen::Engine::record_workload(const std::string& path)
 {
-	auto engine = fen::Engine::Instance();
+	recorder = std::make_unique<WorkloadRecorder>(path);
+	if (!recorder->is_open())
+		recorder.reset();
 
-	auto& e = engine->add_entity();
-	e.set_erase_on_no_components(true);
+	return recorder != nullptr;
+}
+
+fen::Entity& fen::Engine::add_ignored_entity()
+{
+	ignored_entities.emplace(std::numeric_limits<EntityId>::max(), this);
+	auto& e = ignored_entities.back();
+	e.ignored = true;
+	return e;
+}
+
+void fen::Engine::print_times() const
+{
+	profiler.print(stdout);
+}
+
+void fen::Engine::wake_timers(const double dt)
+{
+	elapsed_time += dt;
 
-	//e.add_component<MyComponent>(); // Cannot add a component that the user defines (Im in the engine .lib!)
+	frame_timers.advance(frame_timers.now() + 1, woken_comps);
+	time_timers.advance(static_cast<std::uint64_t>(elapsed_time * 1000.0), woken_comps);
 
-	// Add a component that the user 'tells me' that it should exist
-	e.add_component("MyComponent_2");
+	for (const auto comp : woken_comps)
+		comp->get_owner()->wake(comp);
 
-	// fen does find this component because it isn't created in the user code
-	e.add_component("MyComponent_22");
+	woken_comps.clear();
 }
@@ -1,28 +1,55 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <list>
 #include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <queue>
-
-#include "singleton.h"
+#include <span>
+#include <unordered_map>
 
 #include "entity.h"
-#include "simple_profiler.h"
-#include "profiler_steps_enum.h"
+#include "change_tracker.h"
+#include "timer_wheel.h"
+#include "task_scheduler.h"
+#include "work_queue.h"
+#include "engine_profiler.h"
+#include "metrics.h"
+#include "workload.h"
+#include "reclaimer.h"
+#include "staged_region.h"
+#include "defragmenter.h"
+#include "capacities.h"
+#include "update_pool.h"
+#include "spatial_index.h"
 
 namespace fen
 {
+class Replicator;
 	
-class Engine : public Singleton<Engine>
+/**
+ * \brief A world. Several engines can live in the same process, each one stepped by a single thread at a time.
+ * They share the read only ComponentFactory registry
+ */
+class Engine
 {
-	// Singleton requirements
-	friend Singleton;
+	// Access to the world state (change sets, timers)
+	friend class Entity;
+	friend class Component;
+	friend class WorkloadReplay;
+	friend class Defragmenter;
+	friend class Replicator;
+	friend class ReplicaReceiver;
 
 public:
 
-	virtual ~Engine() override;
+	Engine();
+	~Engine();
 
-	// Singleton requirements
+	// Components and entities point to their world
 	Engine(const Engine& other) = delete;
 	Engine& operator=(const Engine& other) = delete;
 	Engine(Engine&& other) = delete;
@@ -30,38 +57,326 @@ public:
 
 
 	/**
-	 * \brief Cycles until the exit condition is fulfilled
+	 * \brief Cycles until the exit condition is fulfilled and prints the profiling times
 	 */
 	void run();
 
+	/**
+	 * \brief Initializes the starting entities. Call once before step
+	 */
+	void init();
+
+	/**
+	 * \brief Runs a single update and purge cycle
+	 * \return false once the exit condition is fulfilled
+	 */
+	bool step();
+
+	/**
+	 * \brief Prints the profiling times. Prints nothing when FEN_PROFILE_LEVEL is FEN_PROFILE_LEVEL_OFF
+	 */
+	void print_times() const;
+
+	/**
+	 * \brief Stops the world after the current cycle
+	 */
+	void exit() { exit_ = true; }
+
+	[[nodiscard]] bool has_exited() const noexcept { return exit_; }
+
+	/**
+	 * \brief Used by FEN_PROFILE_SCOPE to account user steps to this world
+	 */
+	[[nodiscard]] EngineProfiler& get_profiler() noexcept { return profiler; }
+
+	/**
+	 * \brief Exports the metrics of this world to registry, labeled with world="world_name". Detached when the engine is destroyed
+	 */
+	void register_metrics(MetricsRegistry& registry, const std::string& world_name);
+
+	[[nodiscard]] const EngineMetrics& get_metrics() const noexcept { return metrics; }
+
 	/**
 	 * \brief Adds an entity to the end of the list before the first cycle or after the update cycle
 	 * \return returns the entity reference
 	 */
 	[[nodiscard]] Entity& add_entity()
 	{
-		entities_to_add.emplace();
+		if (ignore_structural_ops)
+			return add_ignored_entity();
+
+		if (recorder != nullptr)
+			recorder->add_entity(next_entity_id);
+
+		entities_to_add.emplace(next_entity_id++, this);
 		return entities_to_add.back();
 	}
 
+	/**
+	 * \brief Records every structural operation and frame dt of this world to a workload log that WorkloadReplay runs again.
+	 * Call before adding the starting entities, operations on entities created earlier cannot be replayed
+	 * \return false if the file cannot be opened
+	 */
+	bool record_workload(const std::string& path);
+
+	/**
+	 * \brief Closes the workload log
+	 */
+	void stop_recording() { recorder.reset(); }
+
+	/**
+	 * \brief Frees the removed entities and components on the reclaimer thread instead of during the purge cycle.
+	 * They are detached from the world and their Destroy is called in place. nullptr frees them in place again.
+	 * The reclaimer must outlive the engine
+	 */
+	void set_reclaimer(Reclaimer* reclaimer_) noexcept { reclaimer = reclaimer_; }
+
+	/**
+	 * \brief Hands entities built outside the world to it. Can be called from any thread.\n
+	 * The entities are committed and initialized after the purge cycle of the next frames, as many as fit in the streaming budget
+	 */
+	void stage(StagedRegion&& region);
+
+	/**
+	 * \brief Removes every entity of region, within the streaming budget of the next frames. Entities of the region
+	 * still staged are dropped
+	 */
+	void unload_region(RegionId region);
+
+	/**
+	 * \brief Time per frame spent committing and unloading streamed entities. 2 ms by default. At least one entity is
+	 * committed and one unloaded per frame
+	 */
+	void set_streaming_budget(const double seconds) noexcept { streaming_budget = seconds; }
+
+	/**
+	 * \brief Time per frame given to the defragmentation pass, run at the end of the frame. 0, the default, disables it.
+	 * While it runs, pointers to entities are only valid until the end of the frame
+	 */
+	void set_defrag_budget(const double seconds) noexcept { defrag_budget = seconds; }
+
+	[[nodiscard]] Defragmenter& get_defragmenter() noexcept { return defrag; }
+
+	/**
+	 * \brief Reserves the memory of the world up front, so the steady state does not reach the system allocator.
+	 * Call before adding the starting entities. capacities.warmup_frames frames later the SlabHeap is sealed and going
+	 * over a capacity is handled by capacities.policy. The defragmentation pass builds the entities it moves next to the
+	 * old ones, keep it off or reserve for twice the entities.\n
+	 * Covers the entities, components and change sets, the wake ups of sleeping components and the spatial index. The
+	 * work queue, the coroutine frames of the behaviours and the functions passed to the engine still allocate from the
+	 * global allocator, outside the capacity policy
+	 */
+	void reserve(const Capacities& capacities);
+
+	/**
+	 * \brief Updates the double buffered components (see BufferedComponent) on n threads besides the one stepping the
+	 * world. They are updated after the other components, on the stepping thread alone when n is 0, the default
+	 */
+	void set_update_threads(unsigned n);
+
+	/**
+	 * \return Proximity queries over the SpatialBody components of this world, as they were at the end of the previous frame
+	 */
+	[[nodiscard]] const SpatialIndex& get_spatial_index() const noexcept { return spatial; }
+
+	/**
+	 * \brief Switches the structure of the spatial index and rebuilds it. A HashGrid with cells of size 4 by default.
+	 * Cells around the usual query radius work best
+	 * \param size Cell size of a HashGrid, box margin of a LooseBvh
+	 */
+	void set_spatial_index(const SpatialIndex::Kind kind, const float size) { spatial.configure(kind, size); }
+
+	/**
+	 * \brief Steps with a constant dt instead of the measured one. 0 to measure it again
+	 */
+	void set_fixed_dt(const double seconds) noexcept { fixed_dt = seconds; }
+
+	/**
+	 * \brief Iterates the components that match Filter during the previous frame
+	 * \tparam Filter added<Comp>, changed<Comp> or removed<Comp>
+	 * \param func For added and changed: func(Entity&, Comp&). For removed: func(EntityId) with the id of the entity that owned it
+	 */
+	template<typename Filter, typename Func>
+	void for_each(Func&& func) const
+	{
+		using Comp = typename Filter::component_type;
+		const auto& changes_ = changes.get(Component::ID<Comp>());
+
+		if constexpr (Filter::kind == ChangeKind::Removed)
+		{
+			for (const auto& e_id : changes_.removed)
+				func(e_id);
+		}
+		else
+		{
+			const auto& comps = Filter::kind == ChangeKind::Added ? changes_.added : changes_.changed;
+			for (const auto& comp : comps)
+			{
+				// Components destroyed after being published are left as nullptr
+				if (comp != nullptr)
+					func(*comp->get_owner(), *static_cast<Comp*>(comp));
+			}
+		}
+	}
+
+	/**
+	 * \brief Iterates the entities of the world that have a Comp (see SharedComponent) grouped by its shared value,
+	 * so the ones that read the same data are visited together
+	 * \param func func(const Comp::data_type&, std::span<Entity* const>) once per distinct value. It must not call
+	 * for_each_group again
+	 */
+	template<concepts::shared Comp, typename Func>
+	void for_each_group(Func&& func)
+	{
+		using Data = typename Comp::data_type;
+
+		assert(!grouping && "for_each_group is not reentrant");
+		grouping = true;
+
+		// Equal values share one address
+		group_keys.clear();
+		for (auto& e : entities)
+		{
+			if (const auto comp = e.get_component<Comp>(); comp != nullptr)
+				group_keys.emplace_back(&comp->get(), &e);
+		}
+		std::sort(group_keys.begin(), group_keys.end(), [](const auto& a, const auto& b) { return std::less<>{}(a.first, b.first); });
+
+		for (std::size_t i = 0; i < group_keys.size();)
+		{
+			const auto data = group_keys[i].first;
+			group_members.clear();
+			for (; i < group_keys.size() && group_keys[i].first == data; ++i)
+				group_members.push_back(group_keys[i].second);
+			func(*static_cast<const Data*>(data), std::span<Entity* const>(group_members));
+		}
+
+		grouping = false;
+	}
+
+	/**
+	 * \brief co_await inside a component behaviour to resume it on the next frame
+	 */
+	[[nodiscard]] NextFrameAwaiter next_frame() noexcept { return { &scheduler }; }
+
+	/**
+	 * \brief co_await inside a component behaviour to resume it after seconds of engine time
+	 */
+	[[nodiscard]] DelayAwaiter delay(const double seconds) noexcept { return { &scheduler, elapsed_time + seconds }; }
+
+	/**
+	 * \brief Time per frame given to the work submitted with submit_work. 2 ms by default
+	 */
+	void set_work_budget(const double seconds) noexcept { work_budget = seconds; }
+
+	/**
+	 * \brief Submits resumable work not owned by any component. See Component::submit_work
+	 */
+	void submit_work(std::function<bool()> step, const int priority = 0) { work.submit(std::move(step), priority, nullptr); }
+
+	/**
+	 * \return Current frame number. Increased after every update and purge cycle
+	 */
+	[[nodiscard]] std::uint32_t frame() const noexcept { return changes.frame(); }
+
 private:
 
-	std::list<Entity> entities;
-	std::queue<std::list<Entity>::iterator> entities_to_remove;
-	std::queue<Entity> entities_to_add;
+	// Pending structural changes, accounted as MemoryTag::Queues
+	template<typename T>
+	using Queue = std::queue<T, std::deque<T, SlabAllocator<T, MemoryTag::Queues>>>;
 
-	bool exit_{false};
+	EntityList entities;
+	Queue<EntityList::iterator> entities_to_remove;
+	Queue<Entity> entities_to_add;
 
-	SimpleProfiler<Steps_Enum::ALL_, double, std::milli> profiler;
+	ChangeTracker changes;
+	EntityId next_entity_id{ 0 };
 
-	// Used to test that the engine can create a component for which it does not know how to make
-	void test_create_unknown_comp();
+	// Sleeping components. One wheel counts frames, the other milliseconds
+	TimerWheel frame_timers;
+	TimerWheel time_timers;
+	double elapsed_time{ 0.0 };
+	SlabVector<Component*, MemoryTag::Queues> woken_comps;
 
-protected:
+	// Suspended component behaviours
+	TaskScheduler scheduler;
 
-	void exit() { exit_ = true; }
+	// Budgeted work run after the behaviours
+	WorkQueue work;
+	double work_budget{ 0.002 };
+
+	// Workload capture and replay
+	std::unique_ptr<WorkloadRecorder> recorder;
+	bool ignore_structural_ops{ false };
+	Queue<Entity> ignored_entities;
+	double fixed_dt{ 0.0 };
+
+	// Entity handed to the components while replaying. Dropped at the end of the frame
+	Entity& add_ignored_entity();
+
+	// Removed entities and components waiting to be handed to the reclaimer at the end of the purge cycle
+	Reclaimer* reclaimer{ nullptr };
+	Reclaimer::Batch graveyard;
+
+	// Streamed regions. Staged ones are handed over by any thread, committed ones are only used by the world
+	std::mutex staging_mutex;
+	std::deque<StagedRegion> staged;
+	std::deque<StagedRegion> committing;
+	std::unordered_map<RegionId, std::list<EntityList::iterator>> regions;
+	std::deque<RegionId> regions_to_unload;
+	double streaming_budget{ 0.002 };
+
+	// Commits and unloads streamed entities until budget seconds are spent. Returns whether streaming work is left
+	bool stream(double budget);
+
+	// Releases an entity of the world list, handing it to the reclaimer if there is one
+	void remove_entity(EntityList::iterator it);
+
+	// Restores the memory order of the entities
+	Defragmenter defrag{ *this };
+	double defrag_budget{ 0.0 };
+
+	// Frame at which this world seals the SlabHeap, see reserve
+	std::uint32_t seal_frame{ 0 };
+	bool seal_pending{ false };
+	bool sealed_heap{ false };
+	bool retains_slabs{ false };
+	CapacityPolicy seal_policy{ CapacityPolicy::Assert };
+
+	// SpatialBody components, updated from the change sets of every step
+	SpatialIndex spatial;
+
+	// Mirrors the changes of every step, see Replicator
+	Replicator* replicator{ nullptr };
+
+	// Moves the components whose sleep ended back to their entity update list
+	void wake_timers(double dt);
+
+	// Double buffered component types, and the threads that update them
+	std::vector<std::uint32_t> buffered_types;
+	std::unique_ptr<UpdatePool> update_pool;
+
+	// First entity of every chunk of the parallel update, gathered during the update cycle
+	static constexpr std::size_t update_chunk_size = 256;
+	SlabVector<EntityList::iterator, MemoryTag::Queues> update_chunks;
+
+	// Scratch of for_each_group: the entities keyed by the address of their shared value, and the current group
+	SlabVector<std::pair<const void*, Entity*>, MemoryTag::Queues> group_keys;
+	SlabVector<Entity*, MemoryTag::Queues> group_members;
+	bool grouping{ false };
+
+	// Updates the double buffered components once the others are done
+	void update_buffered(double dt);
+
+	bool exit_{false};
+
+	// For delta time calculation
+	std::chrono::high_resolution_clock::time_point t_start;
+
+	EngineProfiler profiler;
 
-	Engine() = default;
+	EngineMetrics metrics;
+	MetricsRegistry* metrics_registry{ nullptr };
 };
 
 } // namespace fen
\ No newline at end of file
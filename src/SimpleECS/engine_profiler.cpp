@@ -0,0 +1,93 @@
+#include "engine_profiler.h"
+
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "component_factory.h"
+#include "memory_stats.h"
+
+namespace
+{
+	struct ZoneRange
+	{
+		unsigned base;
+		unsigned count;
+		fen::ProfileZones::Printer printer;
+	};
+
+	// Registered once per user enum, possibly from several world threads
+	std::mutex zones_mutex;
+	std::vector<ZoneRange> zone_ranges;
+	unsigned num_zones = 0;
+}
+
+unsigned fen::ProfileZones::size() noexcept
+{
+	std::scoped_lock lock(zones_mutex);
+	return num_zones;
+}
+
+void fen::ProfileZones::print_name(std::ostream& os, const unsigned zone)
+{
+	std::scoped_lock lock(zones_mutex);
+	for (const auto& r : zone_ranges)
+	{
+		if (zone >= r.base && zone < r.base + r.count)
+		{
+			r.printer(os, zone - r.base);
+			return;
+		}
+	}
+}
+
+unsigned fen::ProfileZones::add(const unsigned count, const Printer printer)
+{
+	std::scoped_lock lock(zones_mutex);
+	zone_ranges.push_back({ num_zones, count, printer });
+	num_zones += count;
+	return zone_ranges.back().base;
+}
+
+void fen::EngineProfiler::print([[maybe_unused]] std::FILE* out) const
+{
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE
+	std::fprintf(out, "Time spent on Init: %.3f %s\n", steps.get_time<Steps_Enum::Init>(), steps.unit());
+
+	if (steps.get_steps() == 0)
+		return;
+
+	std::fprintf(out, "Avg Time spent on Update: %.3f %s\n", steps.get_avg_time<Steps_Enum::Update>(), steps.unit());
+	std::fprintf(out, "Avg Time spent on Purge: %.3f %s\n", steps.get_avg_time<Steps_Enum::Purge>(), steps.unit());
+	std::fprintf(out, "Avg Time spent on Stream: %.3f %s\n", steps.get_avg_time<Steps_Enum::Stream>(), steps.unit());
+	std::fprintf(out, "Avg Time spent on Defrag: %.3f %s\n", steps.get_avg_time<Steps_Enum::Defrag>(), steps.unit());
+#endif
+
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_TYPE
+	using ms = std::chrono::duration<double, std::milli>;
+	const auto frames = static_cast<double>(steps.get_steps());
+
+	const auto factory = ComponentFactory::Instance();
+	for (std::uint32_t i = 0; i < type_times.size(); ++i)
+	{
+		if (type_times[i].count() != 0)
+			std::fprintf(out, "Avg Time spent on %s Update: %.3f ms\n", factory->GetName(i), ms(type_times[i]).count() / frames);
+	}
+#endif
+
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_ZONE
+	for (unsigned i = 0; i < zone_times.size(); ++i)
+	{
+		if (zone_times[i].count() == 0)
+			continue;
+
+		std::ostringstream name;
+		ProfileZones::print_name(name, i);
+		std::fprintf(out, "Avg Time spent on %s: %.3f ms\n", name.str().c_str(), ms(zone_times[i]).count() / frames);
+	}
+#endif
+
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE
+	MemoryStats::print(out);
+#endif
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include "profiler_config.h"
+#include "profiler_steps_enum.h"
+#include "simple_profiler.h"
+#include "tsc_clock.h"
+
+namespace fen
+{
+	namespace concepts
+	{
+		/**
+		 * \brief A user step enum. Like Steps_Enum it needs an ALL_ value with the number of steps and an operator<< to print the names
+		 */
+		template <typename E> concept profile_step_enum = std::is_enum_v<E> && requires(std::ostream& os, E e) { E::ALL_; os << e; };
+	}
+
+#if FEN_PROFILE_TSC
+using ProfileClock = TscClock;
+#else
+using ProfileClock = std::chrono::high_resolution_clock;
+#endif
+
+/**
+ * \brief Assigns every user step enum a range of zone slots shared by all the worlds
+ */
+class ProfileZones
+{
+public:
+
+	using Printer = void(*)(std::ostream&, unsigned);
+
+	template<concepts::profile_step_enum E>
+	[[nodiscard]] static unsigned base() noexcept
+	{
+		static const unsigned b = add(static_cast<unsigned>(E::ALL_), [](std::ostream& os, const unsigned v) { os << static_cast<E>(v); });
+		return b;
+	}
+
+	[[nodiscard]] static unsigned size() noexcept;
+
+	static void print_name(std::ostream& os, unsigned zone);
+
+private:
+
+	static unsigned add(unsigned count, Printer printer);
+};
+
+/**
+ * \brief Profiler of an engine. What it measures is selected at compile time with FEN_PROFILE_LEVEL.
+ * With FEN_PROFILE_LEVEL_OFF it has no members and every call is empty
+ */
+class EngineProfiler
+{
+public:
+
+	static constexpr bool phases = FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE;
+	static constexpr bool types = FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_TYPE;
+	static constexpr bool zones = FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_ZONE;
+
+	using time_point = ProfileClock::time_point;
+
+	EngineProfiler()
+	{
+#if FEN_PROFILE_TSC
+		TscClock::calibrate();
+#endif
+	}
+
+	/**
+	 * \brief Sets the number of component types measured at the TYPE level
+	 */
+	void resize_types([[maybe_unused]] const std::size_t num_types)
+	{
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_TYPE
+		type_times.resize(num_types);
+#endif
+	}
+
+	template<Steps_Enum S>
+	void start_timing()
+	{
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE
+		steps.start_timing<S>();
+#endif
+	}
+
+	template<Steps_Enum S>
+	void finish_timing()
+	{
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE
+		steps.finish_timing<S>();
+#endif
+	}
+
+	void next_step()
+	{
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE
+		steps.next_step();
+#endif
+	}
+
+	[[nodiscard]] static time_point now() noexcept
+	{
+		return ProfileClock::now();
+	}
+
+	/**
+	 * \brief Adds the time since start to the Update time of a component type
+	 */
+	void add_type_time([[maybe_unused]] const std::uint32_t type_id, [[maybe_unused]] const time_point start)
+	{
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_TYPE
+		type_times[type_id] += now() - start;
+#endif
+	}
+
+	/**
+	 * \brief Adds the time since start to a user step
+	 */
+	template<concepts::profile_step_enum E>
+	void add_zone_time([[maybe_unused]] const E step, [[maybe_unused]] const time_point start)
+	{
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_ZONE
+		const auto zone = ProfileZones::base<E>() + static_cast<unsigned>(step);
+		if (zone >= zone_times.size())
+			zone_times.resize(ProfileZones::size());
+		zone_times[zone] += now() - start;
+#endif
+	}
+
+	/**
+	 * \brief Prints the average times of everything measured. Prints nothing when profiling is off
+	 */
+	void print(std::FILE* out) const;
+
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE
+	[[nodiscard]] const SimpleProfiler<Steps_Enum::ALL_, double, std::milli, ProfileClock>& get_steps() const noexcept { return steps; }
+#endif
+
+private:
+
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_PHASE
+	SimpleProfiler<Steps_Enum::ALL_, double, std::milli, ProfileClock> steps;
+#endif
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_TYPE
+	std::vector<ProfileClock::duration> type_times;
+#endif
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_ZONE
+	std::vector<ProfileClock::duration> zone_times;
+#endif
+};
+
+/**
+ * \brief Measures the scope it lives in as a user step
+ */
+template<concepts::profile_step_enum E>
+class ProfileScope
+{
+public:
+
+	ProfileScope(EngineProfiler& profiler_, const E step_) : profiler(profiler_), step(step_), start(EngineProfiler::now()) {}
+	~ProfileScope() { profiler.add_zone_time(step, start); }
+
+	ProfileScope(const ProfileScope& other) = delete;
+	ProfileScope& operator=(const ProfileScope& other) = delete;
+
+private:
+
+	EngineProfiler& profiler;
+	E step;
+	EngineProfiler::time_point start;
+};
+
+} // namespace fen
+
+#define FEN_PROFILE_CONCAT_IMPL(a, b) a##b
+#define FEN_PROFILE_CONCAT(a, b) FEN_PROFILE_CONCAT_IMPL(a, b)
+
+/**
+ * \brief Measures the rest of the scope as the user step. Compiles to nothing below FEN_PROFILE_LEVEL_ZONE
+ * \param engine the world (Engine&) to account the time to
+ * \param step a value of a user step enum (see concepts::profile_step_enum)
+ */
+#if FEN_PROFILE_LEVEL >= FEN_PROFILE_LEVEL_ZONE
+#define FEN_PROFILE_SCOPE(engine, step) const fen::ProfileScope FEN_PROFILE_CONCAT(fen_profile_scope_, __LINE__)((engine).get_profiler(), step)
+#else
+#define FEN_PROFILE_SCOPE(engine, step) ((void)0)
+#endif
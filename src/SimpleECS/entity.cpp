@@ -1,10 +1,12 @@
 #include "entity.h"
 
-#include <iostream>
+#include <cassert>
 
 #include "component_factory.h"
+#include "engine.h"
+#include "update_pool.h"
 
-fen::Entity::Entity(): comps(ComponentFactory::Instance()->GetNumComps(), nullptr), active_comps(), comps_to_remove()
+fen::Entity::Entity(const EntityId id_, Engine* world_): id(id_), world(world_), comps(ComponentFactory::Instance()->GetNumComps(), nullptr), active_comps(), comps_to_remove()
 {
 }
 
@@ -12,57 +14,260 @@ fen::Entity::~Entity()
 {
 	if (!moved)
 	{
-		std::cout << "destroy entity\n";
 		for (auto& comp : active_comps)
 		{
 			delete comp;
 		}
+		for (auto& comp : sleeping_comps)
+		{
+			delete comp;
+		}
+		for (auto& comp : comps_to_init)
+		{
+			delete comp;
+		}
 	}
 }
 
 void fen::Entity::init()
 {
+	initialized = true;
+
 	for(auto it = active_comps.begin(); it != active_comps.end(); ++it)
+		init_component(it);
+}
+
+void fen::Entity::init_component(const ComponentList::iterator it)
+{
+	(*it)->setOwner(this, it);
+	world->changes.on_added(*it);
+	world->metrics.on_component_added((*it)->type_id);
+	(*it)->Init();
+}
+
+void fen::Entity::update(const double dt)
+{
+	for (auto& comp : active_comps)
 	{
-		(*it)->setOwner(this, it);
-		(*it)->Init();
+		// Updated later by update_buffered
+		if (comp->buffered)
+			continue;
+
+		if constexpr (EngineProfiler::types)
+		{
+			const auto start = EngineProfiler::now();
+			comp->Update(dt);
+			world->profiler.add_type_time(comp->type_id, start);
+		}
+		else
+		{
+			comp->Update(dt);
+		}
 	}
 }
 
-void fen::Entity::update(const double dt)
+void fen::Entity::update_buffered(const double dt)
+{
+	for (auto& comp : active_comps)
+	{
+		if (comp->buffered)
+			comp->Update(dt);
+	}
+}
+
+void fen::Entity::report_buffered_writes()
 {
+	const auto frame = world->frame();
 	for (auto& comp : active_comps)
 	{
-		comp->Update(dt);
+		if (comp->buffered && comp->written_frame == frame)
+			comp->mark_changed();
 	}
 }
 
 void fen::Entity::purge()
 {
+	// Init may add more
+	while(!comps_to_init.empty())
+	{
+		const auto it = comps_to_init.begin();
+		active_comps.splice(active_comps.end(), comps_to_init, it);
+		init_component(it);
+	}
+
+	while(!comps_to_sleep.empty())
+	{
+		const auto comp = comps[comps_to_sleep.back()];
+
+		// It may have been woken up or destroyed after the request
+		if (comp != nullptr && comp->sleep_state == Component::SleepState::Requested)
+		{
+			sleeping_comps.splice(sleeping_comps.end(), active_comps, comp->active_comp_it);
+			comp->sleep_state = Component::SleepState::Sleeping;
+			schedule(comp);
+		}
+
+		comps_to_sleep.pop_back();
+	}
+
 	while(!comps_to_remove.empty())
 	{
 		const auto& comp = comps_to_remove.back();
 
-		active_comps.erase(comps[comp]->active_comp_it);
+		detach(comps[comp]);
+		world->changes.on_removed(comps[comp], id);
+		world->metrics.on_component_removed(comp);
 		comps[comp]->Destroy();
+		dispose(comps[comp]);
 		comps[comp] = nullptr;
 
 		comps_to_remove.pop_back();
 	}
 
-	if (erase_on_no_components && active_comps.empty())
+	if (erase_on_no_components && has_no_components())
 		erase = true;
 }
 
+void fen::Entity::wake(Component* comp)
+{
+	if (comp->sleep_state == Component::SleepState::Sleeping)
+	{
+		if (comp->timer.wheel != nullptr)
+			comp->timer.wheel->remove(comp);
+
+		active_comps.splice(active_comps.end(), sleeping_comps, comp->active_comp_it);
+	}
+
+	comp->sleep_state = Component::SleepState::Awake;
+}
+
+void fen::Entity::schedule(Component* comp)
+{
+	if (comp->timer.wheel != nullptr)
+		comp->timer.wheel->remove(comp);
+
+	switch (comp->sleep_clock)
+	{
+	case Component::SleepClock::Frames:	world->frame_timers.insert(comp, comp->timer.deadline); break;
+	case Component::SleepClock::Time:	world->time_timers.insert(comp, comp->timer.deadline); break;
+	case Component::SleepClock::None: break;
+	}
+}
+
+void fen::Entity::detach(Component* comp)
+{
+	if (comp->timer.wheel != nullptr)
+		comp->timer.wheel->remove(comp);
+
+	if (comp->sleep_state == Component::SleepState::Sleeping)
+		sleeping_comps.erase(comp->active_comp_it);
+	else
+		active_comps.erase(comp->active_comp_it);
+}
+
+void fen::Entity::destroy_component(const char* comp_str)
+{
+	std::uint32_t comp_id;
+	if (!can_change_structure() || !ComponentFactory::Instance()->GetId(comp_str, comp_id) || comps[comp_id] == nullptr)
+		return;
+
+	comps_to_remove.push_back(comp_id);
+	record(WorkloadOp::DestroyComponent, comp_id);
+}
+
 void fen::Entity::Destroy()
 {
-	for (auto& comp : active_comps)
+	if (!can_change_structure())
+		return;
+
+	record(WorkloadOp::DestroyEntity);
+
+	// The components are destroyed by the engine, other components of this entity may still be updating
+	erase = true;
+}
+
+void fen::Entity::set_erase_on_no_components(const bool b)
+{
+	if (!can_change_structure())
+		return;
+
+	erase_on_no_components = b;
+
+	if (!ignored && !staged && world->recorder != nullptr)
+		world->recorder->erase_on_no_components(id, b);
+}
+
+bool fen::Entity::can_change_structure() const
+{
+	assert(!UpdatePool::in_parallel_update() && "Structural changes are not allowed while buffered components update");
+
+	return ignored || staged || !world->ignore_structural_ops;
+}
+
+void fen::Entity::record(const WorkloadOp op, const std::uint32_t type_id) const
+{
+	if (ignored || staged || world->recorder == nullptr)
+		return;
+
+	if (op == WorkloadOp::AddComponent || op == WorkloadOp::DestroyComponent)
+		world->recorder->component_op(op, id, type_id);
+	else
+		world->recorder->entity_op(op, id);
+}
+
+void fen::Entity::dispose(Component* comp) const
+{
+	if (world->reclaimer == nullptr)
 	{
 		delete comp;
+		return;
+	}
+
+	comp->cancel_pending();
+	world->graveyard.comps.push_back(comp);
+}
+
+void fen::Entity::record_created() const
+{
+	const auto recorder = world->recorder.get();
+
+	recorder->add_entity(id);
+	if (erase_on_no_components)
+		recorder->erase_on_no_components(id, true);
+	for (const auto comp : active_comps)
+		recorder->component_op(WorkloadOp::AddComponent, id, comp->type_id);
+}
+
+void fen::Entity::release()
+{
+	for (auto& comp : active_comps)
+	{
+		if (initialized)
+		{
+			world->changes.on_removed(comp, id);
+			world->metrics.on_component_removed(comp->type_id);
+		}
+		dispose(comp);
+	}
+	for (auto& comp : sleeping_comps)
+	{
+		if (comp->timer.wheel != nullptr)
+			comp->timer.wheel->remove(comp);
+		if (initialized)
+		{
+			world->changes.on_removed(comp, id);
+			world->metrics.on_component_removed(comp->type_id);
+		}
+		dispose(comp);
 	}
+	for (auto& comp : comps_to_init)
+		dispose(comp);
 	std::fill(comps.begin(), comps.end(), nullptr);
 	active_comps.clear();
+	sleeping_comps.clear();
+	comps_to_init.clear();
 	comps_to_remove.clear();
+	comps_to_sleep.clear();
 
 	erase = true;
 }
@@ -4,6 +4,8 @@
 
 #include "component.h"
 #include "component_factory.h"
+#include "change_tracker.h"
+#include "workload.h"
 
 #include <memory>
 #include <vector>
@@ -11,19 +13,34 @@
 
 namespace fen
 {
+class Engine;
+class Entity;
+
+// Entities of a world, in update order
+using EntityList = std::list<Entity, SlabAllocator<Entity, MemoryTag::Entities>>;
+
 class Entity
 {
 	friend class Engine; // Friend to protect user calling engine related functions (i.e: init, update, purge)
+	friend class Component;
+	friend class WorkloadReplay;
+	friend class StagedRegion;
+	friend class Defragmenter;
+	friend class Replicator;
+	friend class ReplicaReceiver;
 	
 public:
 
-	Entity();
+	Entity(EntityId id_, Engine* world_);
 	~Entity();
 
 	// User defined move constructor in order to prevent a moved entity to be destroyed (performance reasons)
-	Entity(Entity&& e) noexcept : erase(e.erase), erase_on_no_components(e.erase_on_no_components),
+	Entity(Entity&& e) noexcept : id(e.id), world(e.world), initialized(e.initialized), ignored(e.ignored), staged(e.staged),
+	                              region(e.region), region_it(e.region_it),
+	                              erase(e.erase), erase_on_no_components(e.erase_on_no_components),
 	                              comps(std::move(e.comps)), active_comps(std::move(e.active_comps)),
-	                              comps_to_remove(std::move(e.comps_to_remove))
+	                              sleeping_comps(std::move(e.sleeping_comps)), comps_to_init(std::move(e.comps_to_init)),
+	                              comps_to_remove(std::move(e.comps_to_remove)), comps_to_sleep(std::move(e.comps_to_sleep))
 	{
 		if(!e.moved)
 		{
@@ -38,23 +55,30 @@ public:
 	[[nodiscard]] bool has_component() const
 	{
 		assert(Component::ID<Comp>() < comps.size());
-		return comps[Component::ID<Comp>()].get() != nullptr;
+		return comps[Component::ID<Comp>()] != nullptr;
 	}
 
 	/**
-	 * \brief Adds a component to this entity using a component known at compilation time
+	 * \brief Adds a component to this entity using a component known at compilation time. On an initialized entity the
+	 * component is initialized and starts updating after the update cycle
 	 */
 	template<concepts::stricly_derived<Component> Comp>
 	void add_component()
 	{
+		if (!can_change_structure())
+			return;
+
 		const auto comp = ComponentFactory::Instance()->CreateComponent<Comp>();
 		const auto comp_id = Component::ID<Comp>();
 
 		assert(comps[comp_id] == nullptr); // cannot add a component twice
 		assert(comp != nullptr);
 
-		active_comps.push_back(comp);
+		comp->type_id = comp_id;
+		(initialized ? comps_to_init : active_comps).push_back(comp);
 		comps[comp_id] = comp;
+
+		record(WorkloadOp::AddComponent, comp_id);
 	}
 
 	/**
@@ -64,14 +88,24 @@ public:
 	 */
 	void add_component(const char* comp_str)
 	{
+		if (!can_change_structure())
+			return;
+
 		std::uint32_t comp_id;
 		const auto comp = ComponentFactory::Instance()->CreateComponent(comp_str, comp_id);
 
 		// Runtime check because it's using a str
 		if(comp != nullptr && comps[comp_id] == nullptr)
 		{
-			active_comps.push_back(comp);
+			comp->type_id = comp_id;
+			(initialized ? comps_to_init : active_comps).push_back(comp);
 			comps[comp_id] = comp;
+
+			record(WorkloadOp::AddComponent, comp_id);
+		}
+		else
+		{
+			delete comp;
 		}
 	}
 
@@ -82,7 +116,20 @@ public:
 	[[nodiscard]] Comp* get_component() const
 	{
 		assert(Component::ID<Comp>() < comps.size());
-		return comps[Component::ID<Comp>()];
+		return static_cast<Comp*>(comps[Component::ID<Comp>()]);
+	}
+
+	/**
+	 * \brief Same as get_component, but marks the component as changed for this frame
+	 * \return A component if it has it. nullptr if it doesn't
+	 */
+	template<concepts::stricly_derived<Component> Comp>
+	[[nodiscard]] Comp* write_component() const
+	{
+		const auto comp = get_component<Comp>();
+		if (comp != nullptr)
+			comp->mark_changed();
+		return comp;
 	}
 
 	/**
@@ -92,9 +139,18 @@ public:
 	void destroy_component()
 	{
 		assert(Component::ID<Comp>() < comps.size());
+		if (!can_change_structure())
+			return;
+
 		comps_to_remove.push_back(Component::ID<Comp>());
+		record(WorkloadOp::DestroyComponent, Component::ID<Comp>());
 	}
 
+	/**
+	 * \brief Same as destroy_component, using the component type as a string. Does nothing if the entity does not have it
+	 */
+	void destroy_component(const char* comp_str);
+
 	/**
 	 * \brief Destroys this entity after the update cycle. Also destroys the components
 	 */
@@ -103,20 +159,77 @@ public:
 private:
 
 	void init();
+
+	// Sets the owner of a component in active_comps, reports it as added and initializes it
+	void init_component(ComponentList::iterator it);
+
 	void update(const double dt);
+
+	// Updates the double buffered components, possibly from an UpdatePool thread. See BufferedComponent
+	void update_buffered(const double dt);
+
+	// Marks as changed the double buffered components that wrote this frame. On the stepping thread, after the buffered pass
+	void report_buffered_writes();
 	void purge();
 
+	// Destroys the components. Destroy without the workload bookkeeping, used by the engine itself
+	void release();
+
+	// Deletes a removed component, or hands it to the world reclaimer
+	void dispose(Component* comp) const;
+
+	// False while a workload is replayed: the structural operations issued by the components are already in the log
+	[[nodiscard]] bool can_change_structure() const;
+
+	// Writes a structural operation to the workload log when the world is recording one
+	void record(WorkloadOp op, std::uint32_t type_id = 0) const;
+
+	// Writes the operations that built this entity. Used for the entities built outside the world
+	void record_created() const;
+
+	// Moves a sleeping component back to the update list
+	void wake(Component* comp);
+
+	// Puts a sleeping component in the timer wheel of its sleep clock
+	void schedule(Component* comp);
+
+	// Removes a component from whichever list and timer wheel holds it
+	void detach(Component* comp);
+
+	EntityId id;
+
+	// World this entity lives in
+	Engine* world;
+	bool initialized{ false };
+
+	// Created by a component while a workload is replayed. Never added to the world
+	bool ignored{ false };
+
+	// Built in a StagedRegion and not committed yet. It may be on another thread, so it does not read the world
+	bool staged{ false };
+
+	// Region the entity was streamed in with, and its place in the region member list
+	RegionId region{ no_region };
+	std::list<EntityList::iterator>::iterator region_it{};
+
 	bool erase{ false };
 	bool erase_on_no_components{ false };
 	bool moved{ false };
 
-	std::vector<Component*> comps;
-	std::list<Component*> active_comps;
-	std::list<std::uint32_t> comps_to_remove;
+	std::vector<Component*, SlabAllocator<Component*, MemoryTag::ComponentTables>> comps;
+	ComponentList active_comps;
+	ComponentList sleeping_comps;
+
+	// Added after init, initialized by the next purge
+	ComponentList comps_to_init;
+	std::list<std::uint32_t, SlabAllocator<std::uint32_t, MemoryTag::Queues>> comps_to_remove;
+	std::list<std::uint32_t, SlabAllocator<std::uint32_t, MemoryTag::Queues>> comps_to_sleep;
 
 public:
-	void set_erase_on_no_components(const bool b) { erase_on_no_components = b; }
-	[[nodiscard]] bool has_no_components() const { return active_comps.empty(); }
+	void set_erase_on_no_components(bool b);
+	[[nodiscard]] bool has_no_components() const { return active_comps.empty() && sleeping_comps.empty() && comps_to_init.empty(); }
+	[[nodiscard]] EntityId get_id() const noexcept { return id; }
+	[[nodiscard]] Engine* get_world() const noexcept { return world; }
 };
 
 }
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+
+namespace fen
+{
+
+/**
+ * \brief A member of a component sent by the Replicator, packed in bits bits.\n
+ * Integers and enums keep their low bits, signed ones zigzag encoded so small magnitudes stay small. Floating point
+ * members are sent whole, or quantized to bits bits over [min, max] when max > min
+ */
+template<typename C, typename T>
+struct Field
+{
+	T C::* member;
+	unsigned bits;
+	double min{ 0.0 };
+	double max{ 0.0 };
+
+	[[nodiscard]] static constexpr std::uint64_t mask(const unsigned bits) noexcept
+	{
+		return bits >= 64 ? ~std::uint64_t{ 0 } : (std::uint64_t{ 1 } << bits) - 1;
+	}
+
+	[[nodiscard]] std::uint64_t encode(const C& comp) const noexcept
+	{
+		const T& v = comp.*member;
+
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			if (max > min)
+			{
+				const double t = std::clamp((static_cast<double>(v) - min) / (max - min), 0.0, 1.0);
+				return static_cast<std::uint64_t>(std::llround(t * static_cast<double>(mask(bits))));
+			}
+
+			if constexpr (sizeof(T) == sizeof(std::uint32_t))
+				return std::bit_cast<std::uint32_t>(v);
+			else
+				return std::bit_cast<std::uint64_t>(static_cast<double>(v));
+		}
+		else if constexpr (std::is_same_v<T, bool>)
+		{
+			return v ? 1 : 0;
+		}
+		else if constexpr (std::is_enum_v<T>)
+		{
+			return static_cast<std::uint64_t>(static_cast<std::underlying_type_t<T>>(v)) & mask(bits);
+		}
+		else if constexpr (std::is_signed_v<T>)
+		{
+			const auto s = static_cast<std::int64_t>(v);
+			return ((static_cast<std::uint64_t>(s) << 1) ^ static_cast<std::uint64_t>(s >> 63)) & mask(bits);
+		}
+		else
+		{
+			return static_cast<std::uint64_t>(v) & mask(bits);
+		}
+	}
+
+	void decode(C& comp, const std::uint64_t bits_value) const noexcept
+	{
+		T& v = comp.*member;
+
+		if constexpr (std::is_floating_point_v<T>)
+		{
+			if (max > min)
+				v = static_cast<T>(min + (max - min) * static_cast<double>(bits_value) / static_cast<double>(mask(bits)));
+			else if constexpr (sizeof(T) == sizeof(std::uint32_t))
+				v = std::bit_cast<T>(static_cast<std::uint32_t>(bits_value));
+			else
+				v = static_cast<T>(std::bit_cast<double>(bits_value));
+		}
+		else if constexpr (std::is_same_v<T, bool>)
+		{
+			v = bits_value != 0;
+		}
+		else if constexpr (std::is_enum_v<T>)
+		{
+			v = static_cast<T>(static_cast<std::underlying_type_t<T>>(bits_value));
+		}
+		else if constexpr (std::is_signed_v<T>)
+		{
+			v = static_cast<T>(static_cast<std::int64_t>(bits_value >> 1) ^ -static_cast<std::int64_t>(bits_value & 1));
+		}
+		else
+		{
+			v = static_cast<T>(bits_value);
+		}
+	}
+};
+
+/**
+ * \brief A member sent whole, or in its low bits. See Field
+ */
+template<typename C, typename T>
+	requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+[[nodiscard]] constexpr Field<C, T> field(T C::* member, const unsigned bits = std::is_same_v<T, bool> ? 1 : sizeof(T) * 8)
+{
+	assert(bits > 0 && bits <= 64);
+	return { member, bits };
+}
+
+/**
+ * \brief A floating point member sent as bits bits spread over [min, max]. Values out of the range are clamped
+ */
+template<typename C, std::floating_point T>
+[[nodiscard]] constexpr Field<C, T> quantized(T C::* member, const double min, const double max, const unsigned bits)
+{
+	assert(max > min && bits > 0 && bits <= 32);
+	return { member, bits, min, max };
+}
+
+/**
+ * \brief Replicated members of a component, declared as static constexpr auto replicated_fields = layout(...).
+ * At most 64 fields
+ */
+template<typename... F>
+[[nodiscard]] constexpr auto layout(const F... fields)
+{
+	static_assert(sizeof...(F) <= 64, "a replicated layout has at most 64 fields");
+	return std::tuple<F...>(fields...);
+}
+
+} // namespace fen
@@ -0,0 +1,339 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	constexpr std::size_t record_align = 8;
+	constexpr std::size_t min_ring_size = 1024;
+	constexpr auto flush_interval = std::chrono::milliseconds(5);
+
+	constexpr std::size_t aligned(const std::size_t size) { return (size + record_align - 1) & ~(record_align - 1); }
+
+	// Written by its thread, read by the drain. Positions only grow, the offset is the position modulo the capacity.
+	// A record that does not fit before the end leaves a 0 size marker, as little as record_align bytes, and starts
+	// over at offset 0
+	struct Ring
+	{
+		Ring(const std::size_t capacity_, const std::uint32_t thread_) : data(new std::byte[capacity_]), capacity(capacity_), thread(thread_) {}
+
+		std::unique_ptr<std::byte[]> data;
+		std::size_t capacity;
+		std::uint32_t thread;
+
+		alignas(64) std::atomic<std::size_t> head{ 0 };
+		std::size_t pending{ 0 };
+		std::atomic<std::uint64_t> dropped{ 0 };
+
+		alignas(64) std::atomic<std::size_t> tail{ 0 };
+		std::size_t drained{ 0 };
+		std::uint64_t reported{ 0 };
+
+		// Its thread exited, deleted once drained
+		std::atomic<bool> retired{ false };
+	};
+
+	struct State
+	{
+		std::mutex registry_mutex;
+		std::vector<Ring*> rings;
+		std::uint32_t num_threads{ 0 };
+		std::atomic<std::size_t> ring_size{ 64 * 1024 };
+		std::atomic<std::uint64_t> dropped{ 0 };
+
+		std::mutex drain_mutex;
+		std::FILE* out{ stderr };
+		std::vector<Ring*> draining;
+		std::vector<std::pair<std::uint64_t, const std::byte*>> records;
+		std::string text;
+
+		std::mutex flusher_mutex;
+		std::condition_variable flusher_wake;
+		std::thread flusher;
+		bool stop{ false };
+		void (*drain)(){ nullptr };
+
+		const std::chrono::steady_clock::time_point start{ std::chrono::steady_clock::now() };
+	};
+
+	// Never destroyed: threads may log from static destructors
+	State& state()
+	{
+		static auto s = new State;
+		return *s;
+	}
+
+	struct LocalRing
+	{
+		Ring* ring{ nullptr };
+
+		~LocalRing()
+		{
+			if (ring != nullptr)
+				ring->retired.store(true, std::memory_order_release);
+			ring = nullptr;
+		}
+	};
+
+	thread_local LocalRing local;
+
+	void run_flusher()
+	{
+		auto& s = state();
+		std::unique_lock lock(s.flusher_mutex);
+		while (!s.stop)
+		{
+			s.flusher_wake.wait_for(lock, flush_interval);
+			lock.unlock();
+			s.drain();
+			lock.lock();
+		}
+	}
+
+	// Stops the flusher and writes what is left
+	void shutdown()
+	{
+		auto& s = state();
+		{
+			std::lock_guard lock(s.flusher_mutex);
+			s.stop = true;
+		}
+		s.flusher_wake.notify_one();
+		s.flusher.join();
+		s.drain();
+	}
+
+	Ring* attach(void (*drain)())
+	{
+		auto& s = state();
+		std::lock_guard lock(s.registry_mutex);
+		const auto ring = new Ring(s.ring_size.load(std::memory_order_relaxed), s.num_threads++);
+		s.rings.push_back(ring);
+
+		if (s.drain == nullptr)
+		{
+			s.drain = drain;
+			s.flusher = std::thread(&run_flusher);
+			std::atexit(&shutdown);
+		}
+		return ring;
+	}
+
+	void append_time(std::string& text, const std::uint64_t time, const char* level)
+	{
+		char buffer[32];
+		const int n = std::snprintf(buffer, sizeof(buffer), "[%11.6f] %s ", static_cast<double>(time) * 1e-9, level);
+		text.append(buffer, static_cast<std::size_t>(n));
+	}
+}
+
+std::byte* fen::Logger::begin(const std::size_t size)
+{
+	if (local.ring == nullptr)
+		local.ring = attach(&Logger::drain);
+
+	auto& ring = *local.ring;
+	const auto need = aligned(size);
+	const auto head = ring.head.load(std::memory_order_relaxed);
+	const auto offset = head & (ring.capacity - 1);
+	const auto pad = need > ring.capacity - offset ? ring.capacity - offset : 0;
+
+	if (head + pad + need - ring.tail.load(std::memory_order_acquire) > ring.capacity)
+	{
+		ring.dropped.fetch_add(1, std::memory_order_relaxed);
+		state().dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	if (pad != 0)
+	{
+		constexpr std::uint32_t marker = 0;
+		std::memcpy(ring.data.get() + offset, &marker, sizeof(marker));
+	}
+
+	ring.pending = head + pad + need;
+	return ring.data.get() + ((head + pad) & (ring.capacity - 1));
+}
+
+void fen::Logger::commit() noexcept
+{
+	local.ring->head.store(local.ring->pending, std::memory_order_release);
+}
+
+std::uint64_t fen::Logger::now() noexcept
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - state().start).count());
+}
+
+void fen::Logger::drain()
+{
+	auto& s = state();
+	std::lock_guard drain_lock(s.drain_mutex);
+	{
+		std::lock_guard lock(s.registry_mutex);
+		s.draining = s.rings;
+	}
+
+	// The records of all the threads, in the order they were logged
+	s.records.clear();
+	bool any_retired = false;
+	for (const auto ring : s.draining)
+	{
+		// Read before head: a retired ring gets no more records
+		any_retired |= ring->retired.load(std::memory_order_acquire);
+
+		const auto head = ring->head.load(std::memory_order_acquire);
+		for (auto pos = ring->tail.load(std::memory_order_relaxed); pos != head;)
+		{
+			const auto offset = pos & (ring->capacity - 1);
+			const auto record = ring->data.get() + offset;
+
+			// A wrap marker may have less than a header left before the end
+			std::uint32_t size;
+			std::memcpy(&size, record, sizeof(size));
+			if (size == 0)
+			{
+				pos += ring->capacity - offset;
+				continue;
+			}
+
+			Header header;
+			std::memcpy(&header, record, sizeof(header));
+			s.records.emplace_back(header.time, record);
+			pos += aligned(header.size);
+		}
+		ring->drained = head;
+	}
+	std::stable_sort(s.records.begin(), s.records.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+	s.text.clear();
+	for (const auto& record : s.records)
+		format(record.second, s.text);
+
+	for (const auto ring : s.draining)
+	{
+		ring->tail.store(ring->drained, std::memory_order_release);
+
+		const auto dropped = ring->dropped.load(std::memory_order_relaxed);
+		if (dropped != ring->reported)
+		{
+			append_time(s.text, now(), "WARN ");
+			s.text += "logger dropped " + std::to_string(dropped - ring->reported) + " records of thread " + std::to_string(ring->thread) + ", its ring is full\n";
+			ring->reported = dropped;
+		}
+	}
+
+	if (!s.text.empty())
+	{
+		std::fwrite(s.text.data(), 1, s.text.size(), s.out);
+		std::fflush(s.out);
+	}
+
+	if (any_retired)
+	{
+		std::lock_guard lock(s.registry_mutex);
+		std::erase_if(s.rings, [](const Ring* ring)
+		{
+			if (!ring->retired.load(std::memory_order_acquire) || ring->tail.load(std::memory_order_relaxed) != ring->head.load(std::memory_order_acquire))
+				return false;
+			delete ring;
+			return true;
+		});
+	}
+}
+
+void fen::Logger::format(const std::byte* record, std::string& line)
+{
+	static constexpr const char* level_names[] = { "TRACE", "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+	Header header;
+	std::memcpy(&header, record, sizeof(header));
+	append_time(line, header.time, level_names[static_cast<std::size_t>(header.level)]);
+
+	auto arg = record + sizeof(Header);
+	auto left = header.num_args;
+	for (auto f = header.fmt; *f != '\0';)
+	{
+		if (f[0] != '{' || f[1] != '}' || left == 0)
+		{
+			line += *f++;
+			continue;
+		}
+		f += 2;
+		--left;
+
+		const auto type = static_cast<ArgType>(*arg);
+		if (type == ArgType::String)
+		{
+			std::uint32_t len;
+			std::memcpy(&len, arg + 1, sizeof(len));
+			line.append(reinterpret_cast<const char*>(arg + 1 + sizeof(len)), len);
+			arg += 1 + sizeof(len) + len;
+			continue;
+		}
+
+		std::uint64_t bits;
+		std::memcpy(&bits, arg + 1, sizeof(bits));
+		arg += 1 + sizeof(bits);
+
+		char buffer[32];
+		int n = 0;
+		switch (type)
+		{
+		case ArgType::Int:
+			n = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(std::bit_cast<std::int64_t>(bits)));
+			break;
+		case ArgType::Uint:
+			n = std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(bits));
+			break;
+		case ArgType::Float:
+			n = std::snprintf(buffer, sizeof(buffer), "%g", std::bit_cast<double>(bits));
+			break;
+		case ArgType::Bool:
+			n = std::snprintf(buffer, sizeof(buffer), "%s", bits != 0 ? "true" : "false");
+			break;
+		case ArgType::Char:
+			buffer[0] = static_cast<char>(bits);
+			n = 1;
+			break;
+		case ArgType::Pointer:
+			n = std::snprintf(buffer, sizeof(buffer), "0x%llx", static_cast<unsigned long long>(bits));
+			break;
+		case ArgType::String:
+			break;
+		}
+		line.append(buffer, static_cast<std::size_t>(n));
+	}
+	line += '\n';
+}
+
+void fen::Logger::flush()
+{
+	drain();
+}
+
+void fen::Logger::set_output(std::FILE* out)
+{
+	auto& s = state();
+	std::lock_guard lock(s.drain_mutex);
+	s.out = out;
+}
+
+void fen::Logger::set_ring_size(const std::size_t bytes)
+{
+	state().ring_size.store(std::bit_ceil(std::max(bytes, min_ring_size)), std::memory_order_relaxed);
+}
+
+std::uint64_t fen::Logger::dropped() noexcept
+{
+	return state().dropped.load(std::memory_order_relaxed);
+}
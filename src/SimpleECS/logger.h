@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * \brief Log levels. Define FEN_LOG_LEVEL in the project preprocessor definitions to select the lowest one compiled:\n
+ * TRACE, DEBUG, INFO, WARN, ERROR, or OFF for none. The calls below the level compile to nothing, arguments included
+ */
+#define FEN_LOG_LEVEL_TRACE 0
+#define FEN_LOG_LEVEL_DEBUG 1
+#define FEN_LOG_LEVEL_INFO 2
+#define FEN_LOG_LEVEL_WARN 3
+#define FEN_LOG_LEVEL_ERROR 4
+#define FEN_LOG_LEVEL_OFF 5
+
+#ifndef FEN_LOG_LEVEL
+#define FEN_LOG_LEVEL FEN_LOG_LEVEL_INFO
+#endif
+
+namespace fen
+{
+
+enum class LogLevel : std::uint8_t { Trace, Debug, Info, Warn, Error };
+
+/**
+ * \brief Asynchronous logger. Every thread writes its records to its own lock-free ring, and a background thread
+ * formats them and writes them to the output, so logging from a hot path costs a copy of the arguments.\n
+ * The format is kept by pointer and must be a string literal. Each {} is replaced by the next argument: integers,
+ * floating point, bool, char, pointers and strings, which are copied. A record that does not fit in the ring of its
+ * thread is dropped and counted, see dropped
+ */
+class Logger
+{
+public:
+
+	template<typename... Args>
+	static void log(const LogLevel level, const char* fmt, const Args&... args)
+	{
+		const std::size_t size = sizeof(Header) + (arg_size(args) + ... + 0);
+		const auto record = begin(size);
+		if (record == nullptr)
+			return;
+
+		Header header{ static_cast<std::uint32_t>(size), level, static_cast<std::uint8_t>(sizeof...(Args)), now(), fmt };
+		std::memcpy(record, &header, sizeof(header));
+
+		[[maybe_unused]] auto out = record + sizeof(Header);
+		((out = put_arg(out, args)), ...);
+		commit();
+	}
+
+	/**
+	 * \brief Writes every record logged so far, by any thread, and flushes the output. Blocks
+	 */
+	static void flush();
+
+	/**
+	 * \brief Where the records are written. stderr by default
+	 */
+	static void set_output(std::FILE* out);
+
+	/**
+	 * \brief Size of the rings of the threads that log for the first time from now on. 64 KiB by default
+	 */
+	static void set_ring_size(std::size_t bytes);
+
+	/**
+	 * \return Records dropped because the ring of their thread was full
+	 */
+	[[nodiscard]] static std::uint64_t dropped() noexcept;
+
+private:
+
+	enum class ArgType : std::uint8_t { Int, Uint, Float, Bool, Char, String, Pointer };
+
+	struct Header
+	{
+		std::uint32_t size;
+		LogLevel level;
+		std::uint8_t num_args;
+		std::uint64_t time;
+		const char* fmt;
+	};
+
+	// Space for a record in the ring of this thread, nullptr if it is full
+	[[nodiscard]] static std::byte* begin(std::size_t size);
+
+	// Publishes the record returned by begin
+	static void commit() noexcept;
+
+	[[nodiscard]] static std::uint64_t now() noexcept;
+
+	// Writes the records of every ring and reports the drops. One drain at a time
+	static void drain();
+
+	// Appends the text of a record to line
+	static void format(const std::byte* record, std::string& line);
+
+	template<typename T>
+	[[nodiscard]] static constexpr bool is_string() noexcept
+	{
+		return std::is_convertible_v<const T&, std::string_view> && !std::is_same_v<T, std::nullptr_t>;
+	}
+
+	template<typename T>
+	[[nodiscard]] static std::size_t arg_size(const T& arg) noexcept
+	{
+		if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>)
+			return 1 + sizeof(std::uint32_t) + (arg != nullptr ? std::strlen(arg) : sizeof("(null)") - 1);
+		else if constexpr (is_string<T>())
+			return 1 + sizeof(std::uint32_t) + std::string_view(arg).size();
+		else
+			return 1 + sizeof(std::uint64_t);
+	}
+
+	template<typename T>
+	[[nodiscard]] static std::byte* put_arg(std::byte* out, const T& arg) noexcept
+	{
+		if constexpr (std::is_same_v<T, const char*> || std::is_same_v<T, char*>)
+			return put_string(out, arg != nullptr ? std::string_view(arg) : std::string_view("(null)"));
+		else if constexpr (is_string<T>())
+			return put_string(out, std::string_view(arg));
+		else if constexpr (std::is_same_v<T, bool>)
+			return put_value(out, ArgType::Bool, static_cast<std::uint64_t>(arg));
+		else if constexpr (std::is_same_v<T, char>)
+			return put_value(out, ArgType::Char, static_cast<std::uint64_t>(static_cast<unsigned char>(arg)));
+		else if constexpr (std::is_enum_v<T>)
+			return put_arg(out, static_cast<std::underlying_type_t<T>>(arg));
+		else if constexpr (std::is_floating_point_v<T>)
+			return put_raw(out, ArgType::Float, static_cast<double>(arg));
+		else if constexpr (std::is_signed_v<T>)
+			return put_raw(out, ArgType::Int, static_cast<std::int64_t>(arg));
+		else if constexpr (std::is_unsigned_v<T>)
+			return put_value(out, ArgType::Uint, static_cast<std::uint64_t>(arg));
+		else
+		{
+			static_assert(std::is_pointer_v<T> || std::is_null_pointer_v<T>, "argument type not supported by the logger");
+			return put_value(out, ArgType::Pointer, reinterpret_cast<std::uintptr_t>(static_cast<const void*>(arg)));
+		}
+	}
+
+	template<typename V>
+	[[nodiscard]] static std::byte* put_raw(std::byte* out, const ArgType type, const V v) noexcept
+	{
+		static_assert(sizeof(V) == sizeof(std::uint64_t));
+		*out = static_cast<std::byte>(type);
+		std::memcpy(out + 1, &v, sizeof(v));
+		return out + 1 + sizeof(v);
+	}
+
+	[[nodiscard]] static std::byte* put_value(std::byte* out, const ArgType type, const std::uint64_t v) noexcept
+	{
+		return put_raw(out, type, v);
+	}
+
+	[[nodiscard]] static std::byte* put_string(std::byte* out, const std::string_view str) noexcept
+	{
+		const auto len = static_cast<std::uint32_t>(str.size());
+		*out = static_cast<std::byte>(ArgType::String);
+		std::memcpy(out + 1, &len, sizeof(len));
+		std::memcpy(out + 1 + sizeof(len), str.data(), len);
+		return out + 1 + sizeof(len) + len;
+	}
+};
+
+} // namespace fen
+
+#define FEN_LOG_AT(level_, level_enum_, ...) \
+	do { if constexpr (FEN_LOG_LEVEL <= (level_)) ::fen::Logger::log(::fen::LogLevel::level_enum_, __VA_ARGS__); } while (false)
+
+#define FEN_LOG_TRACE(...) FEN_LOG_AT(FEN_LOG_LEVEL_TRACE, Trace, __VA_ARGS__)
+#define FEN_LOG_DEBUG(...) FEN_LOG_AT(FEN_LOG_LEVEL_DEBUG, Debug, __VA_ARGS__)
+#define FEN_LOG_INFO(...) FEN_LOG_AT(FEN_LOG_LEVEL_INFO, Info, __VA_ARGS__)
+#define FEN_LOG_WARN(...) FEN_LOG_AT(FEN_LOG_LEVEL_WARN, Warn, __VA_ARGS__)
+#define FEN_LOG_ERROR(...) FEN_LOG_AT(FEN_LOG_LEVEL_ERROR, Error, __VA_ARGS__)
@@ -0,0 +1,78 @@
+#include "memory_stats.h"
+
+#include <string>
+
+#include "component_factory.h"
+#include "slab_heap.h"
+
+namespace
+{
+	constexpr double kib = 1.0 / 1024.0;
+
+	void print_account(std::FILE* out, const char* name, const fen::MemoryAccount& a)
+	{
+		std::fprintf(out, "Memory of %s: %.1f KiB live (%lld), %.1f KiB peak (%lld)\n", name,
+			static_cast<double>(a.live_bytes.get()) * kib, static_cast<long long>(a.live.get()),
+			static_cast<double>(a.peak_bytes.get()) * kib, static_cast<long long>(a.peak.get()));
+	}
+
+	void attach_account(fen::MetricsRegistry& registry, const void* owner, const fen::MemoryAccount& a, const std::string& prefix, const std::string& what, const std::string& labels)
+	{
+		registry.attach(owner, a.live_bytes, prefix + "_bytes", "Live bytes of " + what, labels);
+		registry.attach(owner, a.peak_bytes, prefix + "_peak_bytes", "High-water mark of the live bytes of " + what, labels);
+		registry.attach(owner, a.live, prefix + "_allocations", "Live allocations of " + what, labels);
+		registry.attach(owner, a.peak, prefix + "_peak_allocations", "High-water mark of the live allocations of " + what, labels);
+	}
+}
+
+const char* fen::MemoryStats::name(const MemoryTag tag) noexcept
+{
+	switch (tag)
+	{
+	case MemoryTag::Entities:			return "Entities";
+	case MemoryTag::ComponentTables:	return "ComponentTables";
+	case MemoryTag::ComponentLists:		return "ComponentLists";
+	case MemoryTag::Queues:				return "Queues";
+	case MemoryTag::ChangeSets:			return "ChangeSets";
+	case MemoryTag::Slabs:				return "Slabs";
+	case MemoryTag::SharedData:			return "SharedData";
+	case MemoryTag::Spatial:			return "Spatial";
+	case MemoryTag::ALL_: break;
+	}
+	return "";
+}
+
+void fen::MemoryStats::print(std::FILE* out)
+{
+	for (std::size_t i = 0; i < accounts.size(); ++i)
+		print_account(out, name(static_cast<MemoryTag>(i)), accounts[i]);
+
+	const auto factory = ComponentFactory::Instance();
+	for (std::uint32_t i = 0; i < factory->GetNumComps(); ++i)
+	{
+		const auto& a = factory->GetMemory(i);
+		if (a.peak.get() != 0)
+			print_account(out, factory->GetName(i), a);
+	}
+
+	if (SlabHeap::is_sealed() || SlabHeap::overflows() != 0)
+		std::fprintf(out, "Allocations over capacity: %llu\n", static_cast<unsigned long long>(SlabHeap::overflows()));
+}
+
+void fen::MemoryStats::register_metrics(MetricsRegistry& registry)
+{
+	for (std::size_t i = 0; i < accounts.size(); ++i)
+	{
+		const std::string n = name(static_cast<MemoryTag>(i));
+		attach_account(registry, &accounts, accounts[i], "fen_memory", "the engine structure", "kind=\"" + n + "\"");
+	}
+
+	const auto factory = ComponentFactory::Instance();
+	for (std::uint32_t i = 0; i < factory->GetNumComps(); ++i)
+		attach_account(registry, &accounts, factory->GetMemory(i), "fen_component_memory", "the component type", "type=\"" + std::string(factory->GetName(i)) + "\"");
+}
+
+void fen::MemoryStats::unregister_metrics(MetricsRegistry& registry)
+{
+	registry.detach(&accounts);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "metrics.h"
+
+namespace fen
+{
+
+/**
+ * \brief Engine structures whose memory is accounted. See SlabAllocator
+ */
+enum class MemoryTag : std::uint8_t
+{
+	Entities,			// Nodes of the world entity lists
+	ComponentTables,	// Per entity table with a slot for every registered component type
+	ComponentLists,		// Nodes of the entity update and sleep lists
+	Queues,				// Pending adds, removes and sleeps, woken components and update chunks
+	ChangeSets,			// Components added, changed and removed in a frame, see ChangeTracker
+	Slabs,				// Slabs held by the SlabHeap, used or not. Everything above but the big blocks lives in them
+	SharedData,			// Deduplicated values of the shared components, see SharedPool
+	Spatial,			// Entries, cells and trees of the spatial indexes
+	ALL_
+};
+
+/**
+ * \brief Live bytes and allocations of one kind of object, with their high-water marks. Safe to update from any thread
+ */
+struct MemoryAccount
+{
+	void on_alloc(const std::size_t bytes) noexcept
+	{
+		peak_bytes.set_max(live_bytes.add(static_cast<std::int64_t>(bytes)));
+		peak.set_max(live.add());
+	}
+
+	void on_free(const std::size_t bytes) noexcept
+	{
+		live_bytes.sub(static_cast<std::int64_t>(bytes));
+		live.sub();
+	}
+
+	Gauge live_bytes;
+	Gauge live;
+	Gauge peak_bytes;
+	Gauge peak;
+};
+
+/**
+ * \brief Memory used by the component types and the engine structures of every world in the process.
+ * Components are accounted per type by their ComponentCreator, see ComponentFactory::GetMemory
+ */
+class MemoryStats
+{
+public:
+
+	[[nodiscard]] static MemoryAccount& get(const MemoryTag tag) noexcept { return accounts[static_cast<std::size_t>(tag)]; }
+
+	[[nodiscard]] static const char* name(MemoryTag tag) noexcept;
+
+	/**
+	 * \brief Prints live and peak memory per engine structure and per component type
+	 */
+	static void print(std::FILE* out);
+
+	/**
+	 * \brief Exports the accounts. They are shared by all the worlds, so register them once per registry
+	 */
+	static void register_metrics(MetricsRegistry& registry);
+
+	/**
+	 * \brief Stops exporting the accounts
+	 */
+	static void unregister_metrics(MetricsRegistry& registry);
+
+private:
+
+	static inline std::array<MemoryAccount, static_cast<std::size_t>(MemoryTag::ALL_)> accounts{};
+};
+
+} // namespace fen
@@ -0,0 +1,77 @@
+#include "metrics.h"
+
+#include <algorithm>
+
+fen::Counter& fen::MetricsRegistry::add_counter(const std::string& name, const std::string& help, const std::string& labels, const double scale)
+{
+	std::scoped_lock lock(mutex);
+	auto& c = own_counters.emplace_back();
+	add_sample(name, help, "counter", { this, &c, nullptr, labels, scale });
+	return c;
+}
+
+fen::Gauge& fen::MetricsRegistry::add_gauge(const std::string& name, const std::string& help, const std::string& labels, const double scale)
+{
+	std::scoped_lock lock(mutex);
+	auto& g = own_gauges.emplace_back();
+	add_sample(name, help, "gauge", { this, nullptr, &g, labels, scale });
+	return g;
+}
+
+void fen::MetricsRegistry::attach(const void* owner, const Counter& c, const std::string& name, const std::string& help, const std::string& labels, const double scale)
+{
+	std::scoped_lock lock(mutex);
+	add_sample(name, help, "counter", { owner, &c, nullptr, labels, scale });
+}
+
+void fen::MetricsRegistry::attach(const void* owner, const Gauge& g, const std::string& name, const std::string& help, const std::string& labels, const double scale)
+{
+	std::scoped_lock lock(mutex);
+	add_sample(name, help, "gauge", { owner, nullptr, &g, labels, scale });
+}
+
+void fen::MetricsRegistry::detach(const void* owner)
+{
+	std::scoped_lock lock(mutex);
+	for (auto it = families.begin(); it != families.end();)
+	{
+		auto& samples = it->second.samples;
+		samples.erase(std::remove_if(samples.begin(), samples.end(), [owner](const Sample& s) { return s.owner == owner; }), samples.end());
+
+		if (samples.empty())
+			it = families.erase(it);
+		else
+			++it;
+	}
+}
+
+void fen::MetricsRegistry::write_prometheus(std::ostream& os) const
+{
+	std::scoped_lock lock(mutex);
+	for (const auto& [name, family] : families)
+	{
+		os << "# HELP " << name << ' ' << family.help << '\n';
+		os << "# TYPE " << name << ' ' << family.type << '\n';
+
+		for (const auto& s : family.samples)
+		{
+			const double value = s.counter != nullptr ? static_cast<double>(s.counter->get()) : static_cast<double>(s.gauge->get());
+
+			os << name;
+			if (!s.labels.empty())
+				os << '{' << s.labels << '}';
+			os << ' ' << value * s.scale << '\n';
+		}
+	}
+}
+
+void fen::MetricsRegistry::add_sample(const std::string& name, const std::string& help, const char* type, Sample sample)
+{
+	auto& family = families[name];
+	if (family.samples.empty())
+	{
+		family.help = help;
+		family.type = type;
+	}
+	family.samples.emplace_back(std::move(sample));
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace fen
+{
+
+/**
+ * \brief Monotonic counter. Updates are relaxed atomics so they can live in hot paths and be read from another thread
+ */
+class Counter
+{
+public:
+	void add(const std::uint64_t n = 1) noexcept { value.fetch_add(n, std::memory_order_relaxed); }
+	[[nodiscard]] std::uint64_t get() const noexcept { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<std::uint64_t> value{ 0 };
+};
+
+/**
+ * \brief Value that goes up and down. Same guarantees as Counter
+ */
+class Gauge
+{
+public:
+	void set(const std::int64_t v) noexcept { value.store(v, std::memory_order_relaxed); }
+	std::int64_t add(const std::int64_t n = 1) noexcept { return value.fetch_add(n, std::memory_order_relaxed) + n; }
+	void sub(const std::int64_t n = 1) noexcept { value.fetch_sub(n, std::memory_order_relaxed); }
+
+	// Raises the value to v if it is lower. Used for high-water marks
+	void set_max(const std::int64_t v) noexcept
+	{
+		auto current = value.load(std::memory_order_relaxed);
+		while (current < v && !value.compare_exchange_weak(current, v, std::memory_order_relaxed)) {}
+	}
+	[[nodiscard]] std::int64_t get() const noexcept { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<std::int64_t> value{ 0 };
+};
+
+/**
+ * \brief Named set of counters and gauges exported in Prometheus text format.\n
+ * Registration takes a lock, updating a registered metric does not
+ */
+class MetricsRegistry
+{
+public:
+
+	/**
+	 * \brief Creates a counter owned by the registry
+	 * \param labels Prometheus labels without braces (i.e: world="0")
+	 * \param scale Factor applied when exporting (i.e: 1e-9 to export nanoseconds as seconds)
+	 */
+	Counter& add_counter(const std::string& name, const std::string& help, const std::string& labels = {}, double scale = 1.0);
+
+	/**
+	 * \brief Creates a gauge owned by the registry
+	 */
+	Gauge& add_gauge(const std::string& name, const std::string& help, const std::string& labels = {}, double scale = 1.0);
+
+	/**
+	 * \brief Exports a counter owned by someone else until detach(owner) is called
+	 */
+	void attach(const void* owner, const Counter& c, const std::string& name, const std::string& help, const std::string& labels = {}, double scale = 1.0);
+
+	/**
+	 * \brief Exports a gauge owned by someone else until detach(owner) is called
+	 */
+	void attach(const void* owner, const Gauge& g, const std::string& name, const std::string& help, const std::string& labels = {}, double scale = 1.0);
+
+	/**
+	 * \brief Stops exporting every metric attached by owner
+	 */
+	void detach(const void* owner);
+
+	/**
+	 * \brief Writes every metric in Prometheus text exposition format
+	 */
+	void write_prometheus(std::ostream& os) const;
+
+private:
+
+	struct Sample
+	{
+		const void* owner;
+		const Counter* counter;
+		const Gauge* gauge;
+		std::string labels;
+		double scale;
+	};
+
+	struct Family
+	{
+		std::string help;
+		const char* type;
+		std::vector<Sample> samples;
+	};
+
+	void add_sample(const std::string& name, const std::string& help, const char* type, Sample sample);
+
+	mutable std::mutex mutex;
+	std::map<std::string, Family> families;
+
+	// Metrics owned by the registry. A deque keeps their addresses stable
+	std::deque<Counter> own_counters;
+	std::deque<Gauge> own_gauges;
+};
+
+/**
+ * \brief Metrics updated by an engine. Attach them to a registry with Engine::register_metrics
+ */
+struct EngineMetrics
+{
+	explicit EngineMetrics(const std::size_t num_types) : components(num_types) {}
+
+	void on_component_added(const std::uint32_t type_id) noexcept { components[type_id].add(); structural_changes.add(); }
+	void on_component_removed(const std::uint32_t type_id) noexcept { components[type_id].sub(); structural_changes.add(); }
+
+	Gauge entities;
+	Gauge pending_adds;
+	Gauge pending_removes;
+	Gauge structural_changes_frame;
+	Gauge tick_time_ns;
+	Gauge work_items;
+	Gauge staged_entities;
+	Gauge fragmentation;
+	Gauge fragmentation_before;
+	Gauge fragmentation_after;
+	Counter structural_changes;
+	Counter streamed_in;
+	Counter streamed_out;
+	Counter relocated_entities;
+	Counter relocated_components;
+	Counter frames;
+	Counter tick_time_ns_total;
+	std::vector<Gauge> components;
+};
+
+} // namespace fen
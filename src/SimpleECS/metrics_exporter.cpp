@@ -0,0 +1,212 @@
+#include "metrics_exporter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "logger.h"
+
+namespace
+{
+	// Also the granularity of the file dump and of the shutdown
+	constexpr long poll_interval_ms = 100;
+
+	// Longest wait on a client that does not send its request or read the response
+	constexpr long client_timeout_ms = 1000;
+
+#ifdef _WIN32
+	using native_socket = SOCKET;
+	void close_socket(const native_socket s) { closesocket(s); }
+	constexpr int send_flags = 0;
+
+	void set_client_options(const native_socket s)
+	{
+		const DWORD timeout = client_timeout_ms;
+		setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+		setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+	}
+#else
+	using native_socket = int;
+	void close_socket(const native_socket s) { close(s); }
+
+	// A peer that closes early must not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+	constexpr int send_flags = MSG_NOSIGNAL;
+#else
+	constexpr int send_flags = 0;
+#endif
+
+	void set_client_options(const native_socket s)
+	{
+		const timeval timeout{ client_timeout_ms / 1000, (client_timeout_ms % 1000) * 1000 };
+		setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+		const int no_sigpipe = 1;
+		setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &no_sigpipe, sizeof(no_sigpipe));
+#endif
+	}
+#endif
+}
+
+fen::MetricsExporter::MetricsExporter(const MetricsRegistry& registry_, Options options_) : registry(registry_), options(std::move(options_))
+{
+	if (options.http_port != 0)
+		open_http();
+
+	thread = std::thread(&MetricsExporter::run, this);
+}
+
+fen::MetricsExporter::~MetricsExporter()
+{
+	stop = true;
+	thread.join();
+
+	if (listen_socket != invalid_socket)
+		close_socket(static_cast<native_socket>(listen_socket));
+
+#ifdef _WIN32
+	if (sockets_started)
+		WSACleanup();
+#endif
+}
+
+void fen::MetricsExporter::run()
+{
+	using clock = std::chrono::steady_clock;
+	auto next_dump = clock::now();
+
+	while (!stop)
+	{
+		if (!options.file.empty() && clock::now() >= next_dump)
+		{
+			dump_file();
+			next_dump = clock::now() + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(options.file_period));
+		}
+
+		// Waits on the socket for up to the poll interval
+		if (listen_socket != invalid_socket)
+			serve_http();
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(poll_interval_ms));
+	}
+
+	// Last values on shutdown
+	if (!options.file.empty())
+		dump_file();
+}
+
+void fen::MetricsExporter::open_http()
+{
+#ifdef _WIN32
+	WSADATA wsa;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+	{
+		FEN_LOG_ERROR("metrics: cannot start the sockets");
+		return;
+	}
+	sockets_started = true;
+#endif
+
+	const native_socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == static_cast<native_socket>(invalid_socket))
+		return;
+
+	const int reuse = 1;
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(options.http_port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 4) != 0)
+	{
+		FEN_LOG_ERROR("metrics: cannot listen on 127.0.0.1:{}", options.http_port);
+		close_socket(s);
+		return;
+	}
+
+	listen_socket = static_cast<Socket>(s);
+}
+
+void fen::MetricsExporter::serve_http()
+{
+	const auto s = static_cast<native_socket>(listen_socket);
+
+	fd_set read_set;
+	FD_ZERO(&read_set);
+	FD_SET(s, &read_set);
+	timeval timeout{ 0, poll_interval_ms * 1000 };
+
+	if (select(static_cast<int>(s) + 1, &read_set, nullptr, nullptr, &timeout) <= 0)
+		return;
+
+	const native_socket client = accept(s, nullptr, nullptr);
+	if (client == static_cast<native_socket>(invalid_socket))
+		return;
+
+	// Blocking, so a silent client would stall the exporter and its shutdown
+	set_client_options(client);
+
+	// The request is not parsed, every path answers with the metrics
+	char request[1024];
+	(void)recv(client, request, sizeof(request), 0);
+
+	std::ostringstream body;
+	registry.write_prometheus(body);
+	const auto body_str = body.str();
+
+	std::ostringstream response;
+	response << "HTTP/1.1 200 OK\r\n"
+		<< "Content-Type: text/plain; version=0.0.4\r\n"
+		<< "Content-Length: " << body_str.size() << "\r\n"
+		<< "Connection: close\r\n\r\n"
+		<< body_str;
+	const auto response_str = response.str();
+
+	std::size_t sent = 0;
+	while (sent < response_str.size())
+	{
+		const auto n = send(client, response_str.data() + sent, static_cast<int>(response_str.size() - sent), send_flags);
+		if (n <= 0)
+			break;
+		sent += static_cast<std::size_t>(n);
+	}
+
+	close_socket(client);
+}
+
+void fen::MetricsExporter::dump_file() const
+{
+	// Written aside and renamed so readers never see a partial file
+	const auto tmp = options.file + ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::trunc);
+		if (!out)
+			return;
+		registry.write_prometheus(out);
+	}
+
+#ifdef _WIN32
+	// rename does not replace an existing file here
+	MoveFileExA(tmp.c_str(), options.file.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	// Replaces the previous file atomically
+	std::rename(tmp.c_str(), options.file.c_str());
+#endif
+}
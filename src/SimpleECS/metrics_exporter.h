@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+
+namespace fen
+{
+
+/**
+ * \brief Background thread that publishes a MetricsRegistry. It can periodically dump the metrics to a file and serve them on
+ * a localhost HTTP endpoint in Prometheus text format. Nothing runs on the engine threads
+ */
+class MetricsExporter
+{
+public:
+
+	struct Options
+	{
+		// File rewritten every file_period seconds. Empty to disable
+		std::string file;
+		double file_period{ 10.0 };
+
+		// Port listened on 127.0.0.1. 0 to disable
+		std::uint16_t http_port{ 0 };
+	};
+
+	MetricsExporter(const MetricsRegistry& registry_, Options options_);
+	~MetricsExporter();
+
+	MetricsExporter(const MetricsExporter& other) = delete;
+	MetricsExporter& operator=(const MetricsExporter& other) = delete;
+
+	/**
+	 * \return false if the HTTP endpoint was requested but could not be opened
+	 */
+	[[nodiscard]] bool is_serving() const noexcept { return options.http_port == 0 || listen_socket != invalid_socket; }
+
+private:
+
+	using Socket = std::intptr_t;
+	static constexpr Socket invalid_socket = -1;
+
+	void run();
+	void open_http();
+	void serve_http();
+	void dump_file() const;
+
+	const MetricsRegistry& registry;
+	Options options;
+
+	Socket listen_socket{ invalid_socket };
+
+	// WSAStartup succeeded and needs its WSACleanup
+	bool sockets_started{ false };
+
+	std::atomic<bool> stop{ false };
+	std::thread thread;
+};
+
+} // namespace fen
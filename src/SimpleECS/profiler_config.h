@@ -0,0 +1,25 @@
+#pragma once
+
+/**
+ * \brief Profiling levels. Define FEN_PROFILE_LEVEL in the project preprocessor definitions to select one:\n
+ * OFF: no profiling code is compiled\n
+ * PHASE: engine phases (Init, Update, Purge)\n
+ * TYPE: PHASE + Update time per component type\n
+ * ZONE: TYPE + user zones (FEN_PROFILE_SCOPE)
+ */
+#define FEN_PROFILE_LEVEL_OFF 0
+#define FEN_PROFILE_LEVEL_PHASE 1
+#define FEN_PROFILE_LEVEL_TYPE 2
+#define FEN_PROFILE_LEVEL_ZONE 3
+
+#ifndef FEN_PROFILE_LEVEL
+#define FEN_PROFILE_LEVEL FEN_PROFILE_LEVEL_PHASE
+#endif
+
+/**
+ * \brief Define FEN_PROFILE_TSC as 1 to time with the CPU time stamp counter instead of the high resolution clock.
+ * Cheaper to read, intended for the TYPE and ZONE levels
+ */
+#ifndef FEN_PROFILE_TSC
+#define FEN_PROFILE_TSC 0
+#endif
@@ -20,6 +20,8 @@ std::ostream& operator<<(std::ostream& os, const Steps_Enum& e)
 	case Steps_Enum::Init:		os << "Init"; break;
 	case Steps_Enum::Update:	os << "Update"; break;
 	case Steps_Enum::Purge:		os << "Purge"; break;
+	case Steps_Enum::Stream:	os << "Stream"; break;
+	case Steps_Enum::Defrag:	os << "Defrag"; break;
 	case Steps_Enum::ALL_: break;
 	}
 	return os;
@@ -5,7 +5,7 @@
  * \brief Profiler steps
  */
 enum Steps_Enum : unsigned {
-	Init, Update, Purge,
+	Init, Update, Purge, Stream, Defrag,
 	ALL_
 };
 
@@ -0,0 +1,93 @@
+#include "reclaimer.h"
+
+#include "component.h"
+
+fen::Reclaimer::Reclaimer(const std::size_t max_pending_) : max_pending(max_pending_)
+{
+	thread = std::thread(&Reclaimer::run, this);
+}
+
+fen::Reclaimer::~Reclaimer()
+{
+	{
+		std::lock_guard lock(mutex);
+		stop = true;
+	}
+	not_empty.notify_one();
+	thread.join();
+}
+
+void fen::Reclaimer::submit(Batch&& batch)
+{
+	const auto n = batch.size();
+	if (n == 0)
+		return;
+
+	{
+		std::unique_lock lock(mutex);
+
+		const auto fits = [this, n] { return pending_objects == 0 || pending_objects + n <= max_pending; };
+		if (!fits())
+		{
+			stalls_.fetch_add(1, std::memory_order_relaxed);
+			drained.wait(lock, fits);
+		}
+
+		pending_objects += n;
+		queue.push_back(std::move(batch));
+
+		batch.comps.clear();
+		if (!spares.empty())
+		{
+			batch.comps.swap(spares.back());
+			spares.pop_back();
+		}
+	}
+	not_empty.notify_one();
+
+	batch.entities.clear();
+}
+
+void fen::Reclaimer::wait_idle()
+{
+	std::unique_lock lock(mutex);
+	drained.wait(lock, [this] { return pending_objects == 0; });
+}
+
+std::size_t fen::Reclaimer::pending() const
+{
+	std::lock_guard lock(mutex);
+	return pending_objects;
+}
+
+void fen::Reclaimer::run()
+{
+	std::unique_lock lock(mutex);
+
+	while (true)
+	{
+		not_empty.wait(lock, [this] { return stop || !queue.empty(); });
+
+		// Whatever is queued is freed before stopping
+		if (queue.empty())
+			break;
+
+		auto batch = std::move(queue.front());
+		queue.pop_front();
+		const auto n = batch.size();
+
+		lock.unlock();
+
+		for (const auto comp : batch.comps)
+			delete comp;
+		batch.comps.clear();
+		batch.entities.clear();
+
+		reclaimed_.fetch_add(n, std::memory_order_relaxed);
+
+		lock.lock();
+		pending_objects -= n;
+		spares.push_back(std::move(batch.comps));
+		drained.notify_all();
+	}
+}
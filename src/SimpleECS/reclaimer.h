@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "entity.h"
+
+namespace fen
+{
+class Component;
+
+/**
+ * \brief Background thread running the destructors and freeing the memory of the components and entities removed
+ * from a world. Several engines may share one, see Engine::set_reclaimer.\n
+ * The queue is bounded: a world submitting while more than max_pending objects are waiting blocks until the thread
+ * catches up. User destructors of components run on this thread and must not touch the world
+ */
+class Reclaimer
+{
+public:
+
+	struct Batch
+	{
+		std::vector<Component*> comps;
+		EntityList entities;
+
+		[[nodiscard]] std::size_t size() const noexcept { return comps.size() + entities.size(); }
+		[[nodiscard]] bool empty() const noexcept { return comps.empty() && entities.empty(); }
+	};
+
+	explicit Reclaimer(std::size_t max_pending_ = 1 << 17);
+
+	// Frees everything still queued
+	~Reclaimer();
+
+	Reclaimer(const Reclaimer& other) = delete;
+	Reclaimer& operator=(const Reclaimer& other) = delete;
+
+	/**
+	 * \brief Queues a batch. Blocks while the queue is full. A batch bigger than the queue waits until the queue is empty
+	 */
+	void submit(Batch&& batch);
+
+	/**
+	 * \brief Blocks until everything submitted has been freed
+	 */
+	void wait_idle();
+
+	[[nodiscard]] std::size_t pending() const;
+
+	/**
+	 * \return Objects freed so far
+	 */
+	[[nodiscard]] std::uint64_t reclaimed() const noexcept { return reclaimed_.load(std::memory_order_relaxed); }
+
+	/**
+	 * \return Times a submit had to wait for the queue to drain
+	 */
+	[[nodiscard]] std::uint64_t stalls() const noexcept { return stalls_.load(std::memory_order_relaxed); }
+
+private:
+
+	void run();
+
+	const std::size_t max_pending;
+
+	mutable std::mutex mutex;
+	std::condition_variable not_empty;
+	std::condition_variable drained;
+
+	std::deque<Batch> queue;
+
+	// Component vectors emptied by the thread, handed back to the next submit so the graveyards keep their capacity
+	std::vector<std::vector<Component*>> spares;
+	std::size_t pending_objects{ 0 };
+	bool stop{ false };
+
+	std::atomic<std::uint64_t> reclaimed_{ 0 };
+	std::atomic<std::uint64_t> stalls_{ 0 };
+
+	std::thread thread;
+};
+
+} // namespace fen
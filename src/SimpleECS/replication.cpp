@@ -0,0 +1,597 @@
+#include "replication.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include "bit_stream.h"
+#include "component_factory.h"
+#include "engine.h"
+
+namespace
+{
+	// Field widths go from 1 to 64
+	constexpr unsigned field_width_bits = 6;
+
+	// Bound on the type ids of a packet, so a malformed one does not grow the type table without limit
+	constexpr std::uint64_t max_types = 1 << 16;
+
+	[[nodiscard]] const std::vector<std::uint8_t>& field_bits(const std::uint32_t type_id)
+	{
+		return fen::ComponentFactory::Instance()->GetFieldBits(type_id);
+	}
+}
+
+fen::Replicator::Replicator(Engine& world_) : world(&world_)
+{
+	assert(world->replicator == nullptr && "a world has one replicator");
+	world->replicator = this;
+
+	type_ticks.resize(ComponentFactory::Instance()->GetNumComps(), 0);
+
+	// The current entities are the state of tick 1, which no baseline is older than
+	for (auto& e : world->entities)
+	{
+		for (const auto comp : e.active_comps)
+			on_added(e.get_id(), comp);
+		for (const auto comp : e.sleeping_comps)
+			on_added(e.get_id(), comp);
+	}
+	touched.clear();
+}
+
+fen::Replicator::~Replicator()
+{
+	if (world != nullptr)
+		world->replicator = nullptr;
+}
+
+fen::Replicator::ObserverId fen::Replicator::add_observer()
+{
+	const auto it = std::find_if(observers.begin(), observers.end(), [](const Observer& o) { return !o.active; });
+	const auto id = static_cast<ObserverId>(it - observers.begin());
+	if (it == observers.end())
+		observers.emplace_back();
+
+	observers[id] = { 0, true };
+	return id;
+}
+
+void fen::Replicator::remove_observer(const ObserverId observer)
+{
+	assert(observer < observers.size());
+	observers[observer].active = false;
+}
+
+void fen::Replicator::acknowledge(const ObserverId observer, const std::uint32_t tick_)
+{
+	assert(observer < observers.size() && observers[observer].active && tick_ <= tick);
+
+	// Acknowledgements may arrive out of order
+	auto& o = observers[observer];
+	o.acked = std::max(o.acked, tick_);
+}
+
+void fen::Replicator::capture()
+{
+	if (world == nullptr)
+		return;
+
+	++tick;
+
+	const auto& changes = world->changes;
+	for (std::uint32_t type_id = 0; type_id < type_ticks.size(); ++type_id)
+	{
+		const auto& c = changes.get(type_id);
+
+		// A component removed and added again in the same frame comes back as a new one
+		for (const auto id : c.removed)
+			on_removed(id, type_id);
+		for (const auto comp : c.added)
+		{
+			if (comp != nullptr && comp->get_owner() != nullptr)
+				on_added(comp->get_owner()->get_id(), comp);
+		}
+		for (const auto comp : c.changed)
+		{
+			if (comp != nullptr && comp->get_owner() != nullptr)
+				on_changed(comp->get_owner()->get_id(), comp);
+		}
+	}
+
+	std::sort(touched.begin(), touched.end());
+	touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+	History h{ tick, {} };
+	if (!spare_touched.empty())
+	{
+		h.entities = std::move(spare_touched.back());
+		spare_touched.pop_back();
+	}
+	std::swap(h.entities, touched);
+	history.push_back(std::move(h));
+
+	trim();
+}
+
+void fen::Replicator::on_added(const EntityId id, const Component* comp)
+{
+	auto& e = entities[id];
+	e.removed = 0;
+
+	const auto type_id = comp->type_id;
+	auto it = std::find_if(e.comps.begin(), e.comps.end(), [type_id](const ComponentState& c) { return c.type_id == type_id; });
+	if (it == e.comps.end())
+		it = e.comps.insert(e.comps.end(), { type_id, tick, 0, {} });
+
+	it->added = tick;
+	it->removed = 0;
+
+	const auto& bits = field_bits(type_id);
+	values.resize(std::max(values.size(), bits.size()));
+	ComponentFactory::Instance()->ReadFields(type_id, comp, values.data());
+
+	it->fields.resize(bits.size());
+	for (std::size_t i = 0; i < bits.size(); ++i)
+		it->fields[i] = { values[i], tick };
+
+	if (type_ticks[type_id] == 0)
+		type_ticks[type_id] = tick;
+
+	++e.live;
+	touched.push_back(id);
+}
+
+void fen::Replicator::on_changed(const EntityId id, const Component* comp)
+{
+	const auto type_id = comp->type_id;
+	const auto& bits = field_bits(type_id);
+	if (bits.empty())
+		return;
+
+	const auto e = entities.find(id);
+	if (e == entities.end())
+		return;
+
+	const auto it = std::find_if(e->second.comps.begin(), e->second.comps.end(),
+		[type_id](const ComponentState& c) { return c.type_id == type_id && c.removed == 0; });
+	if (it == e->second.comps.end())
+		return;
+
+	values.resize(std::max(values.size(), bits.size()));
+	ComponentFactory::Instance()->ReadFields(type_id, comp, values.data());
+
+	// Written to without changing the replicated fields
+	bool changed = false;
+	for (std::size_t i = 0; i < bits.size(); ++i)
+	{
+		if (it->fields[i].value != values[i])
+		{
+			it->fields[i] = { values[i], tick };
+			changed = true;
+		}
+	}
+
+	if (changed)
+		touched.push_back(id);
+}
+
+void fen::Replicator::on_removed(const EntityId id, const std::uint32_t type_id)
+{
+	const auto e = entities.find(id);
+	if (e == entities.end())
+		return;
+
+	const auto it = std::find_if(e->second.comps.begin(), e->second.comps.end(),
+		[type_id](const ComponentState& c) { return c.type_id == type_id && c.removed == 0; });
+	if (it == e->second.comps.end())
+		return;
+
+	it->removed = tick;
+	if (--e->second.live == 0)
+		e->second.removed = tick;
+
+	touched.push_back(id);
+}
+
+void fen::Replicator::trim()
+{
+	// Baselines older than the oldest acknowledged one, or than the history limit, get a full state instead
+	std::uint32_t keep = tick;
+	for (const auto& o : observers)
+	{
+		if (o.active && o.acked != 0)
+			keep = std::min(keep, o.acked);
+	}
+	if (tick > max_history)
+		keep = std::max(keep, tick - max_history);
+
+	while (!history.empty() && history.front().tick <= keep)
+	{
+		auto& h = history.front();
+		for (const auto id : h.entities)
+		{
+			const auto it = entities.find(id);
+			if (it == entities.end())
+				continue;
+
+			auto& e = it->second;
+			if (e.removed != 0 && e.removed <= keep)
+			{
+				entities.erase(it);
+				continue;
+			}
+
+			std::erase_if(e.comps, [keep](const ComponentState& c) { return c.removed != 0 && c.removed <= keep; });
+		}
+
+		h.entities.clear();
+		spare_touched.push_back(std::move(h.entities));
+		history.pop_front();
+	}
+
+	trimmed = std::max(trimmed, keep);
+}
+
+void fen::Replicator::encode(const ObserverId observer, std::vector<std::uint8_t>& out)
+{
+	assert(observer < observers.size() && observers[observer].active);
+
+	const auto acked = observers[observer].acked;
+	const std::uint32_t baseline = acked != 0 && acked >= trimmed ? acked : 0;
+
+	BitWriter writer(out);
+	writer.write_varint(tick);
+	writer.write_varint(baseline);
+
+	// Types first seen after the baseline. Sent by hash, type ids differ between builds
+	std::size_t num_types = 0;
+	for (const auto t : type_ticks)
+		num_types += t != 0 && t > baseline ? 1 : 0;
+
+	writer.write_varint(num_types);
+	for (std::uint32_t type_id = 0; type_id < type_ticks.size(); ++type_id)
+	{
+		if (type_ticks[type_id] == 0 || type_ticks[type_id] <= baseline)
+			continue;
+
+		const auto& bits = field_bits(type_id);
+		writer.write_varint(type_id);
+		writer.write(ComponentFactory::Instance()->GetHash(type_id), 32);
+		writer.write_varint(bits.size());
+		for (const auto b : bits)
+			writer.write(b - 1u, field_width_bits);
+	}
+
+	EntityId previous = 0;
+	if (baseline == 0)
+	{
+		const auto live = std::count_if(entities.begin(), entities.end(), [](const auto& e) { return e.second.removed == 0; });
+		writer.write_varint(static_cast<std::uint64_t>(live));
+
+		for (const auto& [id, e] : entities)
+		{
+			if (e.removed != 0)
+				continue;
+
+			writer.write_varint(id - previous);
+			previous = id;
+			write_entity(writer, e, 0);
+		}
+	}
+	else
+	{
+		gathered.clear();
+		for (auto h = history.rbegin(); h != history.rend() && h->tick > baseline; ++h)
+			gathered.insert(gathered.end(), h->entities.begin(), h->entities.end());
+
+		std::sort(gathered.begin(), gathered.end());
+		gathered.erase(std::unique(gathered.begin(), gathered.end()), gathered.end());
+
+		writer.write_varint(gathered.size());
+		for (const auto id : gathered)
+		{
+			// Kept until no baseline needs it, see trim
+			const auto it = entities.find(id);
+			assert(it != entities.end());
+
+			writer.write_varint(id - previous);
+			previous = id;
+			write_entity(writer, it->second, baseline);
+		}
+	}
+
+	writer.flush();
+}
+
+void fen::Replicator::write_entity(BitWriter& writer, const EntityState& e, const std::uint32_t baseline) const
+{
+	writer.write_bit(e.removed != 0);
+	if (e.removed != 0)
+		return;
+
+	const auto sent = [baseline](const ComponentState& c)
+	{
+		if (c.removed != 0)
+			return c.removed > baseline;
+		return c.added > baseline || std::any_of(c.fields.begin(), c.fields.end(), [baseline](const FieldState& f) { return f.tick > baseline; });
+	};
+
+	writer.write_varint(static_cast<std::uint64_t>(std::count_if(e.comps.begin(), e.comps.end(), sent)));
+	for (const auto& c : e.comps)
+	{
+		if (!sent(c))
+			continue;
+
+		writer.write_varint(c.type_id);
+		writer.write_bit(c.removed != 0);
+		if (c.removed != 0)
+			continue;
+
+		// Created after the baseline: every field, without the changed bits
+		const auto& bits = field_bits(c.type_id);
+		const bool full = c.added > baseline;
+		writer.write_bit(full);
+		for (std::size_t i = 0; i < bits.size(); ++i)
+		{
+			const bool changed = full || c.fields[i].tick > baseline;
+			if (!full)
+				writer.write_bit(changed);
+			if (changed)
+				writer.write(c.fields[i].value, bits[i]);
+		}
+	}
+}
+
+fen::ReplicaReceiver::ReplicaReceiver(Engine& world_) : world(&world_)
+{
+}
+
+bool fen::ReplicaReceiver::apply(const std::uint8_t* data, const std::size_t size)
+{
+	BitReader reader(data, size);
+
+	const auto packet_tick = static_cast<std::uint32_t>(reader.read_varint());
+	const auto baseline = static_cast<std::uint32_t>(reader.read_varint());
+
+	// A delta needs a state at least as recent as its baseline, a full state only needs to be newer
+	if (reader.has_failed() || packet_tick <= tick || baseline > tick)
+		return false;
+
+	// Decoded whole before touching the world, so a rejected packet leaves the replica as it was
+	if (!decode(reader))
+		return false;
+
+	const auto factory = ComponentFactory::Instance();
+
+	for (const auto& def : decoded_types)
+	{
+		if (def.remote_id >= types.size())
+			types.resize(def.remote_id + 1);
+
+		auto& t = types[def.remote_id];
+		const auto bits = decoded_bits.begin() + static_cast<std::ptrdiff_t>(def.first_bit);
+		t.field_bits.assign(bits, bits + static_cast<std::ptrdiff_t>(def.num_fields));
+		t.resolved = factory->GetIdFromHash(def.hash, t.local_id) && factory->GetFieldBits(t.local_id) == t.field_bits;
+	}
+
+	index_entities();
+	seen.clear();
+
+	for (const auto& record : decoded_entities)
+	{
+		if (record.removed)
+		{
+			const auto local = local_ids.find(record.id);
+			if (local == local_ids.end())
+				continue;
+
+			if (const auto e = entities.find(local->second); e != entities.end())
+				e->second->Destroy();
+			local_ids.erase(local);
+			continue;
+		}
+
+		seen.push_back(record.id);
+		const auto e = find_or_add(record.id);
+		listed.clear();
+
+		for (std::size_t c = record.first_comp; c < record.first_comp + record.num_comps; ++c)
+		{
+			const auto& comp_record = decoded_comps[c];
+			const auto& t = types[comp_record.remote_type];
+
+			if (comp_record.removed)
+			{
+				if (t.resolved)
+					remove_component(*e, t.local_id);
+				continue;
+			}
+
+			if (t.resolved)
+				listed.push_back(t.local_id);
+
+			const auto comp = t.resolved ? e->comps[t.local_id] : nullptr;
+
+			auto target = comp;
+			if (target == nullptr && t.resolved)
+			{
+				e->add_component(factory->GetName(t.local_id));
+				target = e->comps[t.local_id];
+			}
+
+			if (target == nullptr)
+			{
+				++unresolved;
+				continue;
+			}
+
+			if (comp_record.mask != 0)
+			{
+				factory->WriteFields(t.local_id, target, decoded_values.data() + comp_record.first_value, comp_record.mask);
+				target->mark_changed();
+			}
+		}
+
+		// A full state lists every component of the entity: the others were removed before it
+		if (baseline == 0)
+		{
+			for (std::uint32_t type_id = 0; type_id < e->comps.size(); ++type_id)
+			{
+				if (e->comps[type_id] != nullptr && std::find(listed.begin(), listed.end(), type_id) == listed.end())
+					remove_component(*e, type_id);
+			}
+		}
+	}
+
+	// A full state replaces the replica: what it does not list is gone
+	if (baseline == 0)
+	{
+		std::sort(seen.begin(), seen.end());
+		for (auto it = local_ids.begin(); it != local_ids.end();)
+		{
+			if (std::binary_search(seen.begin(), seen.end(), it->first))
+			{
+				++it;
+				continue;
+			}
+
+			if (const auto e = entities.find(it->second); e != entities.end())
+				e->second->Destroy();
+			it = local_ids.erase(it);
+		}
+	}
+
+	tick = packet_tick;
+	return true;
+}
+
+bool fen::ReplicaReceiver::decode(BitReader& reader)
+{
+	decoded_types.clear();
+	decoded_bits.clear();
+	decoded_entities.clear();
+	decoded_comps.clear();
+	decoded_values.clear();
+
+	const auto num_types = reader.read_varint();
+	for (std::uint64_t i = 0; i < num_types && !reader.has_failed(); ++i)
+	{
+		const auto remote_id = reader.read_varint();
+		const auto hash = static_cast<std::uint32_t>(reader.read(32));
+		const auto num_fields = reader.read_varint();
+		if (remote_id >= max_types || num_fields > 64)
+			return false;
+
+		decoded_types.push_back({ static_cast<std::uint32_t>(remote_id), hash, decoded_bits.size(), static_cast<std::size_t>(num_fields) });
+		for (std::uint64_t f = 0; f < num_fields; ++f)
+			decoded_bits.push_back(static_cast<std::uint8_t>(reader.read(field_width_bits) + 1));
+	}
+
+	EntityId id = 0;
+	const auto num_entities = reader.read_varint();
+	for (std::uint64_t n = 0; n < num_entities && !reader.has_failed(); ++n)
+	{
+		id += static_cast<EntityId>(reader.read_varint());
+
+		EntityRecord record{ id, reader.read_bit(), decoded_comps.size(), 0 };
+		if (!record.removed)
+		{
+			const auto num_comps = reader.read_varint();
+			for (std::uint64_t c = 0; c < num_comps && !reader.has_failed(); ++c)
+			{
+				const auto remote_type = reader.read_varint();
+				std::span<const std::uint8_t> bits;
+				if (!find_field_bits(remote_type, bits))
+					return false;
+
+				ComponentRecord comp{ static_cast<std::uint32_t>(remote_type), reader.read_bit(), 0, decoded_values.size() };
+				if (!comp.removed)
+				{
+					const bool full = reader.read_bit();
+					decoded_values.resize(decoded_values.size() + bits.size());
+					for (std::size_t i = 0; i < bits.size(); ++i)
+					{
+						if (full || reader.read_bit())
+						{
+							decoded_values[comp.first_value + i] = reader.read(bits[i]);
+							comp.mask |= std::uint64_t{ 1 } << i;
+						}
+					}
+				}
+				decoded_comps.push_back(comp);
+				++record.num_comps;
+			}
+		}
+		decoded_entities.push_back(record);
+	}
+
+	return !reader.has_failed();
+}
+
+bool fen::ReplicaReceiver::find_field_bits(const std::uint64_t remote_type, std::span<const std::uint8_t>& bits) const
+{
+	// The definitions in the packet replace the known ones
+	for (auto def = decoded_types.rbegin(); def != decoded_types.rend(); ++def)
+	{
+		if (def->remote_id == remote_type)
+		{
+			bits = { decoded_bits.data() + def->first_bit, def->num_fields };
+			return true;
+		}
+	}
+
+	if (remote_type >= types.size())
+		return false;
+
+	bits = types[remote_type].field_bits;
+	return true;
+}
+
+void fen::ReplicaReceiver::remove_component(Entity& e, const std::uint32_t type_id)
+{
+	const auto comp = e.comps[type_id];
+	if (comp == nullptr)
+		return;
+
+	// Not initialized yet, the removal undoes the add
+	if (comp->get_owner() == nullptr)
+	{
+		(e.initialized ? e.comps_to_init : e.active_comps).remove(comp);
+		e.comps[type_id] = nullptr;
+		delete comp;
+		return;
+	}
+
+	// Sent again until the removal is acknowledged
+	const auto& pending = e.comps_to_remove;
+	if (std::find(pending.begin(), pending.end(), type_id) == pending.end())
+		e.destroy_component(ComponentFactory::Instance()->GetName(type_id));
+}
+
+void fen::ReplicaReceiver::index_entities()
+{
+	if (indexed_frame == world->frame())
+		return;
+
+	// Entities added by the last apply were initialized by the step that advanced the frame
+	entities.clear();
+	for (auto& e : world->entities)
+		entities[e.get_id()] = &e;
+
+	indexed_frame = world->frame();
+}
+
+fen::Entity* fen::ReplicaReceiver::find_or_add(const EntityId remote_id)
+{
+	if (const auto local = local_ids.find(remote_id); local != local_ids.end())
+	{
+		if (const auto e = entities.find(local->second); e != entities.end())
+			return e->second;
+	}
+
+	// Unknown here, or removed by the world itself
+	auto& e = world->add_entity();
+	local_ids[remote_id] = e.get_id();
+	entities[e.get_id()] = &e;
+	return &e;
+}
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "change_tracker.h"
+
+namespace fen
+{
+class Engine;
+class Entity;
+class BitWriter;
+class BitReader;
+
+/**
+ * \brief Streams the state of a world to observers as deltas against the last state each one acknowledged.\n
+ * After every step the world change sets are folded into a mirror that keeps, per component, the tick it was added
+ * or removed and, per replicated field (see concepts::replicated), its packed value and the tick it last changed.
+ * encode() then writes only what changed after the observer baseline: entities and components created or removed and
+ * the changed fields, bit packed. Types without a layout only replicate their existence.\n
+ * Only what goes through the change sets is seen: components written without mark_changed or write_component are
+ * not sent. Entities are replicated through their components, an entity whose last component is removed is destroyed
+ * on the replicas.\n
+ * Packets: tick and baseline varints, the type definitions the baseline does not have (type id, Component::Hash and
+ * field widths), then the entity records sorted by id. Baseline 0 is a full state that replaces the replica contents
+ */
+class Replicator
+{
+	friend class Engine;
+
+public:
+
+	using ObserverId = std::uint32_t;
+
+	/**
+	 * \brief Starts mirroring world, from its current entities. Detached when either is destroyed
+	 */
+	explicit Replicator(Engine& world);
+	~Replicator();
+
+	Replicator(const Replicator& other) = delete;
+	Replicator& operator=(const Replicator& other) = delete;
+
+	[[nodiscard]] ObserverId add_observer();
+	void remove_observer(ObserverId observer);
+
+	/**
+	 * \brief The observer applied the packet of tick. Later packets are deltas against it
+	 */
+	void acknowledge(ObserverId observer, std::uint32_t tick);
+
+	/**
+	 * \brief Appends to out the packet that brings the observer from its acknowledged tick to the current one
+	 */
+	void encode(ObserverId observer, std::vector<std::uint8_t>& out);
+
+	/**
+	 * \return Tick of the last captured step. The state when the Replicator was created is tick 1
+	 */
+	[[nodiscard]] std::uint32_t get_tick() const noexcept { return tick; }
+
+	/**
+	 * \brief Ticks of history kept for observers that do not acknowledge. Older baselines get a full state. 256 by default
+	 */
+	void set_max_history(const std::uint32_t ticks) noexcept { max_history = ticks; }
+
+private:
+
+	struct FieldState
+	{
+		std::uint64_t value;
+		std::uint32_t tick;
+	};
+
+	struct ComponentState
+	{
+		std::uint32_t type_id;
+		std::uint32_t added;
+		std::uint32_t removed{ 0 };
+		std::vector<FieldState> fields;
+	};
+
+	struct EntityState
+	{
+		std::uint32_t removed{ 0 };
+		std::uint32_t live{ 0 };
+		std::vector<ComponentState> comps;
+	};
+
+	struct Observer
+	{
+		std::uint32_t acked{ 0 };
+		bool active{ false };
+	};
+
+	// Entities touched in a tick
+	struct History
+	{
+		std::uint32_t tick;
+		std::vector<EntityId> entities;
+	};
+
+	// Folds the changes published by the last step into the mirror. Called by the world after every step
+	void capture();
+
+	void on_added(EntityId id, const Component* comp);
+	void on_changed(EntityId id, const Component* comp);
+	void on_removed(EntityId id, std::uint32_t type_id);
+
+	// Drops the history and the removed entries no observer needs any more
+	void trim();
+
+	// Writes what changed in e after baseline
+	void write_entity(BitWriter& writer, const EntityState& e, std::uint32_t baseline) const;
+
+	Engine* world;
+	std::uint32_t tick{ 1 };
+
+	std::map<EntityId, EntityState> entities;
+
+	// Tick each type was first seen in, 0 if never
+	std::vector<std::uint32_t> type_ticks;
+
+	std::deque<History> history;
+	std::vector<EntityId> touched;
+	std::vector<std::vector<EntityId>> spare_touched;
+	std::vector<EntityId> gathered;
+
+	// Baselines up to this tick lost their history and removed entries
+	std::uint32_t trimmed{ 0 };
+	std::uint32_t max_history{ 256 };
+
+	std::vector<Observer> observers;
+	std::vector<std::uint64_t> values;
+};
+
+/**
+ * \brief Applies the packets of a Replicator to another world, creating its own entities and components.
+ * The world may be stepped between packets. Packets that do not follow the applied state are rejected, acknowledge
+ * get_tick() to the Replicator after every apply
+ */
+class ReplicaReceiver
+{
+public:
+
+	explicit ReplicaReceiver(Engine& world);
+
+	/**
+	 * \return false if the packet was rejected: malformed, older than the state or against a baseline it does not have.
+	 * A rejected packet changes nothing
+	 */
+	bool apply(const std::uint8_t* data, std::size_t size);
+
+	/**
+	 * \return Tick of the last applied packet, 0 before the first one
+	 */
+	[[nodiscard]] std::uint32_t get_tick() const noexcept { return tick; }
+
+	/**
+	 * \return Components skipped because their type is unknown here or has a different layout
+	 */
+	[[nodiscard]] std::size_t get_unresolved() const noexcept { return unresolved; }
+
+private:
+
+	struct RemoteType
+	{
+		std::uint32_t local_id{ 0 };
+		bool resolved{ false };
+		std::vector<std::uint8_t> field_bits;
+	};
+
+	// Packet decoded by decode, applied once it is known to be well formed. Field values are stored for every field of
+	// a component, the mask tells the ones sent
+	struct TypeRecord
+	{
+		std::uint32_t remote_id;
+		std::uint32_t hash;
+		std::size_t first_bit;
+		std::size_t num_fields;
+	};
+
+	struct ComponentRecord
+	{
+		std::uint32_t remote_type;
+		bool removed;
+		std::uint64_t mask;
+		std::size_t first_value;
+	};
+
+	struct EntityRecord
+	{
+		EntityId id;
+		bool removed;
+		std::size_t first_comp;
+		std::size_t num_comps;
+	};
+
+	// Reads the rest of the packet after tick and baseline. False if it is malformed or uses an unknown type
+	[[nodiscard]] bool decode(BitReader& reader);
+
+	// Field widths of a type, as defined by the packet being decoded or by an earlier one
+	[[nodiscard]] bool find_field_bits(std::uint64_t remote_type, std::span<const std::uint8_t>& bits) const;
+
+	// Removes a component of an entity built here, at once if the entity is not initialized yet
+	static void remove_component(Entity& e, std::uint32_t type_id);
+
+	// Entities of the world by id. Rebuilt when the world stepped, entities move when they are initialized
+	void index_entities();
+
+	[[nodiscard]] Entity* find_or_add(EntityId remote_id);
+
+	Engine* world;
+	std::uint32_t tick{ 0 };
+
+	std::vector<RemoteType> types;
+
+	// Remote entity id to the id of the entity built here
+	std::unordered_map<EntityId, EntityId> local_ids;
+	std::unordered_map<EntityId, Entity*> entities;
+	std::uint32_t indexed_frame{ 0 };
+
+	std::size_t unresolved{ 0 };
+	std::vector<EntityId> seen;
+	std::vector<std::uint32_t> listed;
+
+	std::vector<TypeRecord> decoded_types;
+	std::vector<std::uint8_t> decoded_bits;
+	std::vector<EntityRecord> decoded_entities;
+	std::vector<ComponentRecord> decoded_comps;
+	std::vector<std::uint64_t> decoded_values;
+};
+
+} // namespace fen
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include "component.h"
+#include "component_concepts.h"
+#include "memory_stats.h"
+#include "type_hash.h"
+
+namespace fen
+{
+template<concepts::shareable Data>
+class SharedRef;
+
+/**
+ * \brief Immutable values of Data shared by every SharedRef to an equal value. There is a single pool per Data type,
+ * shared by the worlds of the process. Safe to use from any thread, values are freed when their last reference is
+ * dropped. The default value is kept alive, so components that never set one do not allocate
+ */
+template<concepts::shareable Data>
+class SharedPool
+{
+	friend class SharedRef<Data>;
+
+public:
+
+	// Never destroyed: components may be freed by static destructors or by a reclaimer thread still running at exit
+	[[nodiscard]] static SharedPool& Instance()
+	{
+		static auto pool = new SharedPool;
+		return *pool;
+	}
+
+	SharedPool(const SharedPool& other) = delete;
+	SharedPool& operator=(const SharedPool& other) = delete;
+
+	/**
+	 * \return Distinct values alive, the default one included
+	 */
+	[[nodiscard]] std::size_t size()
+	{
+		std::lock_guard lock(mutex);
+		return blocks.size();
+	}
+
+private:
+
+	struct Block
+	{
+		explicit Block(const Data& data_, const std::size_t hash_) : data(data_), hash(hash_) {}
+
+		const Data data;
+		const std::size_t hash;
+		std::atomic<std::uint32_t> refs{ 1 };
+	};
+
+	SharedPool() : default_block(intern(Data{})) {}
+
+	[[nodiscard]] static std::size_t hash_of(const Data& data) noexcept
+	{
+		if constexpr (requires { std::hash<Data>{}(data); })
+			return std::hash<Data>{}(data);
+		else
+			return fnv1a(std::string_view(reinterpret_cast<const char*>(&data), sizeof(Data)));
+	}
+
+	// Block holding a value equal to data, with a reference for the caller
+	[[nodiscard]] Block* intern(const Data& data)
+	{
+		const auto hash = hash_of(data);
+
+		std::lock_guard lock(mutex);
+		const auto [first, last] = blocks.equal_range(hash);
+		for (auto it = first; it != last; ++it)
+		{
+			if (it->second->data == data)
+			{
+				it->second->refs.fetch_add(1, std::memory_order_relaxed);
+				return it->second;
+			}
+		}
+
+		const auto block = new Block(data, hash);
+		MemoryStats::get(MemoryTag::SharedData).on_alloc(sizeof(Block));
+		blocks.emplace(hash, block);
+		return block;
+	}
+
+	static void acquire(Block* block) noexcept
+	{
+		block->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Drops a reference. Only the pool adds references to a block without holding one, and it does it under the lock,
+	// so the last one is dropped there too
+	void release(Block* block)
+	{
+		auto refs = block->refs.load(std::memory_order_relaxed);
+		while (refs > 1)
+		{
+			if (block->refs.compare_exchange_weak(refs, refs - 1, std::memory_order_release, std::memory_order_relaxed))
+				return;
+		}
+
+		std::lock_guard lock(mutex);
+		if (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+			return;
+
+		const auto [first, last] = blocks.equal_range(block->hash);
+		for (auto it = first; it != last; ++it)
+		{
+			if (it->second == block)
+			{
+				blocks.erase(it);
+				break;
+			}
+		}
+		MemoryStats::get(MemoryTag::SharedData).on_free(sizeof(Block));
+		delete block;
+	}
+
+	std::mutex mutex;
+	std::unordered_multimap<std::size_t, Block*> blocks;
+
+	// Referenced by the pool itself, never freed
+	Block* default_block;
+};
+
+/**
+ * \brief Reference to an immutable value of Data in its SharedPool. Equal values are the same object, so two
+ * references compare equal, and get() returns the same address, only if their values are equal. A moved from
+ * reference can only be assigned or destroyed
+ */
+template<concepts::shareable Data>
+class SharedRef
+{
+public:
+
+	/**
+	 * \brief References the default value
+	 */
+	SharedRef() : block(SharedPool<Data>::Instance().default_block) { SharedPool<Data>::acquire(block); }
+
+	/**
+	 * \brief References the value equal to data, adding it to the pool if there is none
+	 */
+	explicit SharedRef(const Data& data) : block(SharedPool<Data>::Instance().intern(data)) {}
+
+	SharedRef(const SharedRef& other) noexcept : block(other.block) { SharedPool<Data>::acquire(block); }
+	SharedRef(SharedRef&& other) noexcept : block(std::exchange(other.block, nullptr)) {}
+
+	SharedRef& operator=(SharedRef other) noexcept
+	{
+		std::swap(block, other.block);
+		return *this;
+	}
+
+	~SharedRef()
+	{
+		if (block != nullptr)
+			SharedPool<Data>::Instance().release(block);
+	}
+
+	[[nodiscard]] const Data& get() const noexcept { return block->data; }
+	[[nodiscard]] const Data* operator->() const noexcept { return &block->data; }
+	[[nodiscard]] const Data& operator*() const noexcept { return block->data; }
+
+	/**
+	 * \return References to this value, the ones held by the pool included
+	 */
+	[[nodiscard]] std::uint32_t use_count() const noexcept { return block->refs.load(std::memory_order_relaxed); }
+
+	[[nodiscard]] bool operator==(const SharedRef& other) const noexcept { return block == other.block; }
+
+private:
+
+	typename SharedPool<Data>::Block* block;
+};
+
+/**
+ * \brief Component whose Data is shared with every component holding an equal value, so thousands of entities with
+ * the same configuration keep a single copy of it. The value is immutable: set and modify build the new value aside and
+ * share the equal one if it already exists, copy on write. Starts with the default value.\n
+ * Entities can be grouped by value with Engine::for_each_group
+ */
+template<concepts::shareable Data>
+class SharedComponent : public Component
+{
+public:
+
+	static constexpr bool shared = true;
+	using data_type = Data;
+
+	[[nodiscard]] const Data& get() const noexcept { return ref.get(); }
+	[[nodiscard]] const SharedRef<Data>& get_ref() const noexcept { return ref; }
+
+	/**
+	 * \brief Shares the value of another reference, without copying or looking it up. Marks the component as changed
+	 */
+	void share(const SharedRef<Data>& other)
+	{
+		if (other == ref)
+			return;
+
+		ref = other;
+		mark_changed();
+	}
+
+	/**
+	 * \brief Shares the value equal to data. Marks the component as changed
+	 */
+	void set(const Data& data) { share(SharedRef<Data>(data)); }
+
+	/**
+	 * \brief Calls func(Data&) on a private copy of the value and shares the result
+	 */
+	template<typename Func>
+	void modify(Func&& func)
+	{
+		Data data = ref.get();
+		func(data);
+		set(data);
+	}
+
+private:
+
+	SharedRef<Data> ref;
+};
+
+} // namespace fen
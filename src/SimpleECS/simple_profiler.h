@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include <array>
+#include <cassert>
 #include <chrono>
 #include <numeric>
 
@@ -13,7 +14,7 @@ namespace fen
 		template <unsigned N, typename Precision, typename TimeRatio> concept valid_profiler = N > 0 && std::is_floating_point_v<Precision> && std::_Is_ratio_v<TimeRatio>;
 	}
 
-template<unsigned N, typename Precision, typename TimeRatio = std::ratio<1, 1>> // Default as seconds
+template<unsigned N, typename Precision, typename TimeRatio = std::ratio<1, 1>, typename Clock = std::chrono::high_resolution_clock> // Default as seconds
 	requires concepts::valid_profiler<N, Precision, TimeRatio>
 class SimpleProfiler
 {
@@ -24,7 +25,7 @@ private:
 	template <> [[nodiscard]] constexpr const char* _get_unit<std::nano>()			const noexcept { return "ns"; }
 	template <> [[nodiscard]] constexpr const char* _get_unit<std::ratio<1, 1>>()	const noexcept { return "s"; }
 
-	using hr_clock = std::chrono::high_resolution_clock;
+	using hr_clock = Clock;
 	using timing_array = std::array<std::chrono::time_point<hr_clock>, N>;
 	using duration_cast = std::chrono::duration<Precision, TimeRatio>;
 
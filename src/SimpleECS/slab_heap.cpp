@@ -0,0 +1,449 @@
+#include "slab_heap.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+
+#include "logger.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+	using fen::SlabHeap;
+
+	constexpr std::size_t num_classes = SlabHeap::max_size / SlabHeap::granularity;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	// Lives at the start of its slab, so a block finds it by masking its address
+	struct Slab
+	{
+		// Links in the list of slabs with holes of its class
+		Slab* prev{ nullptr };
+		Slab* next{ nullptr };
+		bool has_holes{ false };
+
+		FreeBlock* free{ nullptr };
+		std::size_t live{ 0 };
+
+		// Offset of the first block never handed out
+		std::size_t top;
+	};
+
+	constexpr std::size_t header_size = (sizeof(Slab) + SlabHeap::granularity - 1) / SlabHeap::granularity * SlabHeap::granularity;
+
+	struct SizeClass
+	{
+		std::mutex mutex;
+		Slab* current{ nullptr };
+		Slab* evacuation{ nullptr };
+		Slab* holes{ nullptr };
+
+		// Empty slabs kept for later, linked by next
+		Slab* spares{ nullptr };
+	};
+
+	struct Heap
+	{
+		std::array<SizeClass, num_classes> classes;
+
+		// Unmatched retain_empty_slabs and seal calls
+		std::atomic<std::uint32_t> retainers{ 0 };
+		std::atomic<std::uint32_t> seals{ 0 };
+		std::atomic<bool> lock_memory{ false };
+		std::atomic<fen::CapacityPolicy> policy{ fen::CapacityPolicy::Assert };
+		std::atomic<std::uint64_t> overflows{ 0 };
+		std::atomic<bool> warned_overflow{ false };
+		std::atomic<bool> warned_lock{ false };
+	};
+
+	// Never destroyed: components may be freed by static destructors or by a reclaimer thread still running at exit
+	Heap& heap()
+	{
+		static auto h = new Heap;
+		return *h;
+	}
+
+	thread_local bool evacuating = false;
+
+	// Free blocks a thread keeps per size class, so most allocations and frees skip the class lock
+	constexpr std::size_t cache_bytes = 4096;
+
+	constexpr std::size_t cache_limit(const std::size_t c)
+	{
+		return std::clamp<std::size_t>(cache_bytes / ((c + 1) * SlabHeap::granularity), 4, 64);
+	}
+
+	// Trivially destructible, so the thread_local destructors that run after CacheOwner still find it, closed
+	struct ThreadCache
+	{
+		std::array<FreeBlock*, num_classes> blocks{};
+		std::array<std::uint32_t, num_classes> count{};
+		bool attached{ false };
+		bool closed{ false };
+	};
+
+	thread_local ThreadCache cache;
+
+	// Gives the cached blocks back when its thread exits
+	struct CacheOwner
+	{
+		~CacheOwner();
+	};
+
+	thread_local CacheOwner cache_owner;
+
+	constexpr std::size_t class_of(const std::size_t size) { return (size + SlabHeap::granularity - 1) / SlabHeap::granularity - 1; }
+
+	Slab* slab_of(void* ptr) { return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(ptr) & ~(SlabHeap::slab_size - 1)); }
+
+	void warn_once(std::atomic<bool>& warned, const char* msg)
+	{
+		if (!warned.exchange(true, std::memory_order_relaxed))
+			FEN_LOG_WARN("{}", msg);
+	}
+
+	// Applies the capacity policy to an allocation about to reach the system
+	void on_system_alloc()
+	{
+		auto& h = heap();
+		if (h.seals.load(std::memory_order_relaxed) == 0)
+			return;
+
+		h.overflows.fetch_add(1, std::memory_order_relaxed);
+		switch (h.policy.load(std::memory_order_relaxed))
+		{
+		case fen::CapacityPolicy::Assert:
+			assert(false && "SlabHeap capacity exceeded");
+			break;
+		case fen::CapacityPolicy::Fail:
+			throw std::bad_alloc();
+		case fen::CapacityPolicy::Grow:
+			break;
+		}
+		warn_once(h.warned_overflow, "SlabHeap capacity exceeded, allocating from the system");
+	}
+
+	Slab* system_slab()
+	{
+		const auto mem = ::operator new(SlabHeap::slab_size, std::align_val_t{ SlabHeap::slab_size });
+		fen::MemoryStats::get(fen::MemoryTag::Slabs).on_alloc(SlabHeap::slab_size);
+
+		if (heap().lock_memory.load(std::memory_order_relaxed))
+		{
+#ifdef _WIN32
+			const bool locked = VirtualLock(mem, SlabHeap::slab_size) != 0;
+#else
+			const bool locked = mlock(mem, SlabHeap::slab_size) == 0;
+#endif
+			if (!locked)
+				warn_once(heap().warned_lock, "SlabHeap could not lock its memory, raise the locked memory limit of the process");
+		}
+
+		return new (mem) Slab{ .top = header_size };
+	}
+
+	Slab* new_slab(SizeClass& c)
+	{
+		if (c.spares != nullptr)
+		{
+			const auto slab = c.spares;
+			c.spares = slab->next;
+			slab->next = nullptr;
+			return slab;
+		}
+
+		on_system_alloc();
+		return system_slab();
+	}
+
+	void free_slab(SizeClass& c, Slab* slab)
+	{
+		if (heap().retainers.load(std::memory_order_relaxed) > 0)
+		{
+			slab->free = nullptr;
+			slab->top = header_size;
+			slab->next = c.spares;
+			c.spares = slab;
+			return;
+		}
+
+		// Locked pages are unlocked when the memory is released
+		slab->~Slab();
+		::operator delete(slab, std::align_val_t{ SlabHeap::slab_size });
+		fen::MemoryStats::get(fen::MemoryTag::Slabs).on_free(SlabHeap::slab_size);
+	}
+
+	void link_holes(SizeClass& c, Slab* slab)
+	{
+		slab->prev = nullptr;
+		slab->next = c.holes;
+		if (c.holes != nullptr)
+			c.holes->prev = slab;
+		c.holes = slab;
+		slab->has_holes = true;
+	}
+
+	void unlink_holes(SizeClass& c, Slab* slab)
+	{
+		if (!slab->has_holes)
+			return;
+
+		if (slab->prev != nullptr)
+			slab->prev->next = slab->next;
+		else
+			c.holes = slab->next;
+		if (slab->next != nullptr)
+			slab->next->prev = slab->prev;
+
+		slab->prev = slab->next = nullptr;
+		slab->has_holes = false;
+	}
+
+	// Takes a block of the class. Its lock is held
+	void* take(SizeClass& sc, const std::size_t block_size)
+	{
+		if (!evacuating && sc.holes != nullptr)
+		{
+			const auto slab = sc.holes;
+			const auto block = slab->free;
+			slab->free = block->next;
+			if (slab->free == nullptr)
+				unlink_holes(sc, slab);
+			++slab->live;
+			return block;
+		}
+
+		auto& slab = evacuating ? sc.evacuation : sc.current;
+		if (slab == nullptr || slab->top + block_size > SlabHeap::slab_size)
+			slab = new_slab(sc);
+
+		const auto block = reinterpret_cast<char*>(slab) + slab->top;
+		slab->top += block_size;
+		++slab->live;
+		return block;
+	}
+
+	// Gives a block back to its slab. The lock of its class is held
+	void give(SizeClass& sc, void* ptr)
+	{
+		const auto slab = slab_of(ptr);
+		if (--slab->live == 0)
+		{
+			unlink_holes(sc, slab);
+
+			// The slabs being filled start over, the others go back to the system
+			if (slab == sc.current || slab == sc.evacuation)
+			{
+				slab->free = nullptr;
+				slab->top = header_size;
+			}
+			else
+			{
+				free_slab(sc, slab);
+			}
+			return;
+		}
+
+		const auto block = static_cast<FreeBlock*>(ptr);
+		block->next = slab->free;
+		slab->free = block;
+		if (!slab->has_holes)
+			link_holes(sc, slab);
+	}
+
+	void cache_push(const std::size_t c, void* ptr)
+	{
+		const auto block = static_cast<FreeBlock*>(ptr);
+		block->next = cache.blocks[c];
+		cache.blocks[c] = block;
+		++cache.count[c];
+	}
+
+	// Gives n cached blocks of class c back under a single lock
+	void cache_flush(const std::size_t c, std::size_t n)
+	{
+		auto& sc = heap().classes[c];
+		std::lock_guard lock(sc.mutex);
+		for (; n > 0 && cache.blocks[c] != nullptr; --n)
+		{
+			const auto block = cache.blocks[c];
+			cache.blocks[c] = block->next;
+			--cache.count[c];
+			give(sc, block);
+		}
+	}
+
+	CacheOwner::~CacheOwner()
+	{
+		cache.closed = true;
+		for (std::size_t c = 0; c < num_classes; ++c)
+			cache_flush(c, cache.count[c]);
+	}
+}
+
+void* fen::SlabHeap::allocate(const std::size_t size)
+{
+	const auto c = class_of(size > 0 ? size : 1);
+	if (c >= num_classes)
+	{
+		on_system_alloc();
+		return ::operator new(size);
+	}
+
+	if (!evacuating && cache.blocks[c] != nullptr)
+	{
+		const auto block = cache.blocks[c];
+		cache.blocks[c] = block->next;
+		--cache.count[c];
+		return block;
+	}
+
+	const auto block_size = (c + 1) * granularity;
+	auto& sc = heap().classes[c];
+	std::lock_guard lock(sc.mutex);
+	const auto block = take(sc, block_size);
+	if (evacuating || cache.closed)
+		return block;
+
+	// Half a cache more while the lock is held, from the memory at hand: a new slab is only taken for the block asked for.
+	// Pushed last first, so consecutive allocations keep the address order of the slab
+	std::array<void*, cache_limit(0) / 2> refill;
+	std::size_t n = 0;
+	while (n < cache_limit(c) / 2 && (sc.holes != nullptr || (sc.current != nullptr && sc.current->top + block_size <= slab_size)))
+		refill[n++] = take(sc, block_size);
+	while (n > 0)
+		cache_push(c, refill[--n]);
+	return block;
+}
+
+void fen::SlabHeap::deallocate(void* ptr, const std::size_t size) noexcept
+{
+	const auto c = class_of(size > 0 ? size : 1);
+	if (c >= num_classes)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	if (!cache.closed)
+	{
+		if (!cache.attached)
+		{
+			// Registers the flush at thread exit
+			[[maybe_unused]] const auto& owner = cache_owner;
+			cache.attached = true;
+		}
+
+		if (cache.count[c] == cache_limit(c))
+			cache_flush(c, cache_limit(c) / 2);
+		cache_push(c, ptr);
+		return;
+	}
+
+	auto& sc = heap().classes[c];
+	std::lock_guard lock(sc.mutex);
+	give(sc, ptr);
+}
+
+void fen::SlabHeap::reserve(const std::size_t size, const std::size_t count)
+{
+	const auto c = class_of(size > 0 ? size : 1);
+	if (c >= num_classes || count == 0)
+		return;
+
+	const auto per_slab = (slab_size - header_size) / ((c + 1) * granularity);
+	auto& sc = heap().classes[c];
+	std::lock_guard lock(sc.mutex);
+
+	for (std::size_t n = (count + per_slab - 1) / per_slab; n > 0; --n)
+	{
+		const auto slab = system_slab();
+		slab->next = sc.spares;
+		sc.spares = slab;
+	}
+}
+
+void fen::SlabHeap::retain_empty_slabs() noexcept
+{
+	heap().retainers.fetch_add(1, std::memory_order_relaxed);
+}
+
+void fen::SlabHeap::release_empty_slabs() noexcept
+{
+	auto& h = heap();
+	const auto previous = h.retainers.fetch_sub(1, std::memory_order_relaxed);
+	assert(previous > 0 && "release_empty_slabs without retain_empty_slabs");
+	if (previous != 1)
+		return;
+
+	// The world going away most likely freed its blocks into the cache of this thread, their slabs may become spares
+	for (std::size_t c = 0; c < num_classes; ++c)
+		cache_flush(c, cache.count[c]);
+
+	for (auto& sc : h.classes)
+	{
+		std::lock_guard lock(sc.mutex);
+
+		// Retained again meanwhile
+		if (h.retainers.load(std::memory_order_relaxed) > 0)
+			return;
+
+		while (sc.spares != nullptr)
+		{
+			const auto slab = sc.spares;
+			sc.spares = slab->next;
+			free_slab(sc, slab);
+		}
+	}
+}
+
+void fen::SlabHeap::seal(const CapacityPolicy policy) noexcept
+{
+	heap().policy.store(policy, std::memory_order_relaxed);
+	heap().seals.fetch_add(1, std::memory_order_relaxed);
+}
+
+void fen::SlabHeap::unseal() noexcept
+{
+	[[maybe_unused]] const auto previous = heap().seals.fetch_sub(1, std::memory_order_relaxed);
+	assert(previous > 0 && "unseal without seal");
+}
+
+bool fen::SlabHeap::is_sealed() noexcept
+{
+	return heap().seals.load(std::memory_order_relaxed) > 0;
+}
+
+std::uint64_t fen::SlabHeap::overflows() noexcept
+{
+	return heap().overflows.load(std::memory_order_relaxed);
+}
+
+void fen::SlabHeap::set_lock_memory(const bool b) noexcept
+{
+	heap().lock_memory.store(b, std::memory_order_relaxed);
+}
+
+fen::SlabHeap::Evacuation::Evacuation() noexcept : previous(evacuating)
+{
+	evacuating = true;
+}
+
+fen::SlabHeap::Evacuation::~Evacuation()
+{
+	evacuating = previous;
+}
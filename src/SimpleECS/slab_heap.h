@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "memory_stats.h"
+
+namespace fen
+{
+
+/**
+ * \brief What the SlabHeap does, once sealed, when a size class runs out of reserved slabs
+ */
+enum class CapacityPolicy : std::uint8_t
+{
+	Assert,	// Asserts in debug builds. Grows with a warning otherwise
+	Fail,	// Throws std::bad_alloc
+	Grow,	// Takes memory from the system and warns once
+};
+
+/**
+ * \brief Size class allocator backing the components, the entity nodes and their component tables and lists.\n
+ * Blocks of a class are carved from 64 KiB slabs. Holes left by freed blocks are reused first, then the current slab
+ * grows, and a slab left empty goes back to the system. A thread holding an Evacuation skips the holes and fills fresh
+ * slabs in allocation order, which is how the Defragmenter lays a world out in update order.\n
+ * For a steady state without system allocations, reserve slabs up front (see Engine::reserve), retain the empty slabs
+ * and seal the heap: empty slabs are then kept as spares, and needing more memory is a capacity overflow.
+ * Retaining and sealing are counted, so every world releases its own and the heap stays sealed while any world wants it.\n
+ * Shared by every world and thread safe, each size class has its own lock. Each thread keeps up to 4 KiB of free
+ * blocks per class in front of it, refilled and flushed half at a time, so most allocations and frees take no lock.
+ * Cached blocks stay out of their slabs until the cache fills or the thread exits, leave some headroom in the reserves
+ */
+class SlabHeap
+{
+public:
+
+	static constexpr std::size_t slab_size = 64 * 1024;
+	static constexpr std::size_t granularity = 16;
+
+	// Bigger requests go to the global allocator
+	static constexpr std::size_t max_size = 1024;
+
+	[[nodiscard]] static void* allocate(std::size_t size);
+	static void deallocate(void* ptr, std::size_t size) noexcept;
+
+	/**
+	 * \brief Adds spare slabs for count more blocks of size bytes. Sizes over max_size cannot be reserved.
+	 * Spares are only kept once used and emptied while the empty slabs are retained
+	 */
+	static void reserve(std::size_t size, std::size_t count);
+
+	/**
+	 * \brief Keeps the slabs left empty as spares until every call is matched by a release_empty_slabs
+	 */
+	static void retain_empty_slabs() noexcept;
+
+	/**
+	 * \brief Matches a retain_empty_slabs. The last one gives the spare slabs back to the system
+	 */
+	static void release_empty_slabs() noexcept;
+
+	/**
+	 * \brief Taking memory from the system is a capacity overflow handled by policy until every call is matched by an
+	 * unseal. The policy of the last call applies
+	 */
+	static void seal(CapacityPolicy policy) noexcept;
+	static void unseal() noexcept;
+	[[nodiscard]] static bool is_sealed() noexcept;
+
+	/**
+	 * \return Allocations that took memory from the system while sealed
+	 */
+	[[nodiscard]] static std::uint64_t overflows() noexcept;
+
+	/**
+	 * \brief Locks the slabs taken from the system from now on in physical memory (mlock / VirtualLock).
+	 * Warns once if the system refuses, the slabs are used anyway
+	 */
+	static void set_lock_memory(bool b) noexcept;
+
+	/**
+	 * \brief While alive, the allocations of the calling thread go to fresh slabs, one after another
+	 */
+	class Evacuation
+	{
+	public:
+		Evacuation() noexcept;
+		~Evacuation();
+
+		Evacuation(const Evacuation& other) = delete;
+		Evacuation& operator=(const Evacuation& other) = delete;
+
+	private:
+		bool previous;
+	};
+};
+
+/**
+ * \brief Standard allocator over SlabHeap, for the containers of the world. Accounts what it holds to Tag
+ */
+template<typename T, MemoryTag Tag>
+class SlabAllocator
+{
+public:
+	using value_type = T;
+
+	template<typename U>
+	struct rebind { using other = SlabAllocator<U, Tag>; };
+
+	SlabAllocator() noexcept = default;
+
+	template<typename U>
+	SlabAllocator(const SlabAllocator<U, Tag>&) noexcept {}
+
+	[[nodiscard]] T* allocate(const std::size_t n)
+	{
+		static_assert(alignof(T) <= SlabHeap::granularity, "Over aligned types are not supported");
+		const auto ptr = static_cast<T*>(SlabHeap::allocate(n * sizeof(T)));
+		MemoryStats::get(Tag).on_alloc(n * sizeof(T));
+		return ptr;
+	}
+
+	void deallocate(T* ptr, const std::size_t n) noexcept
+	{
+		MemoryStats::get(Tag).on_free(n * sizeof(T));
+		SlabHeap::deallocate(ptr, n * sizeof(T));
+	}
+
+	template<typename U>
+	bool operator==(const SlabAllocator<U, Tag>&) const noexcept { return true; }
+};
+
+template<typename T, MemoryTag Tag>
+using SlabVector = std::vector<T, SlabAllocator<T, Tag>>;
+
+} // namespace fen
@@ -0,0 +1,481 @@
+#include "spatial_index.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "component_creator.h"
+#include "entity.h"
+
+namespace fen
+{
+	ADD_COMPONENT(SpatialBody)
+}
+
+namespace
+{
+	using fen::Aabb;
+	using fen::Vec3;
+
+	// Cell coordinates are packed in 21 bits per axis
+	constexpr std::int64_t cell_range = 1 << 20;
+
+	[[nodiscard]] std::int64_t cell_coord(const float v, const float cell_size)
+	{
+		const auto c = static_cast<std::int64_t>(std::floor(v / cell_size));
+		return std::clamp(c, -cell_range, cell_range - 1);
+	}
+
+	constexpr std::uint64_t cell_mask = (std::uint64_t{ 1 } << 21) - 1;
+
+	[[nodiscard]] std::uint64_t pack_cell(const std::int64_t x, const std::int64_t y, const std::int64_t z)
+	{
+		return (static_cast<std::uint64_t>(x + cell_range) & cell_mask)
+			| (static_cast<std::uint64_t>(y + cell_range) & cell_mask) << 21
+			| (static_cast<std::uint64_t>(z + cell_range) & cell_mask) << 42;
+	}
+
+	// Coordinate of a packed cell along axis 0, 1 or 2
+	[[nodiscard]] std::int64_t cell_axis(const std::uint64_t cell, const unsigned axis)
+	{
+		return static_cast<std::int64_t>(cell >> (21 * axis) & cell_mask) - cell_range;
+	}
+
+	[[nodiscard]] Aabb merge(const Aabb& a, const Aabb& b)
+	{
+		return { { std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) },
+			{ std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) } };
+	}
+
+	[[nodiscard]] float area(const Aabb& a)
+	{
+		const float dx = a.max.x - a.min.x;
+		const float dy = a.max.y - a.min.y;
+		const float dz = a.max.z - a.min.z;
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	[[nodiscard]] bool contains(const Aabb& outer, const Aabb& inner)
+	{
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+			&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+	}
+
+	// Traversal stack of the tree queries, one per thread so parallel queries do not share it
+	thread_local std::vector<std::int32_t> stack;
+}
+
+void fen::SpatialIndex::query_radius(const std::span<const Sphere> queries, std::vector<SpatialEntry>& hits, std::vector<std::uint32_t>& offsets) const
+{
+	offsets.clear();
+	offsets.push_back(static_cast<std::uint32_t>(hits.size()));
+	for (const auto& q : queries)
+	{
+		for_each_in_radius(q.center, q.radius, [&hits](const SpatialEntry& e) { hits.push_back(e); });
+		offsets.push_back(static_cast<std::uint32_t>(hits.size()));
+	}
+}
+
+void fen::SpatialIndex::query_box(const std::span<const Aabb> queries, std::vector<SpatialEntry>& hits, std::vector<std::uint32_t>& offsets) const
+{
+	offsets.clear();
+	offsets.push_back(static_cast<std::uint32_t>(hits.size()));
+	for (const auto& q : queries)
+	{
+		for_each_in_box(q, [&hits](const SpatialEntry& e) { hits.push_back(e); });
+		offsets.push_back(static_cast<std::uint32_t>(hits.size()));
+	}
+}
+
+void fen::SpatialIndex::visit(const Aabb& box, const Visitor visitor, const Query& query) const
+{
+	if (entries.empty())
+		return;
+
+	if (kind == Kind::HashGrid)
+	{
+		// Cells outside the occupied ones are not probed
+		const auto x0 = std::max(cell_coord(box.min.x - max_radius, cell_size), occupied[0]), x1 = std::min(cell_coord(box.max.x + max_radius, cell_size), occupied[3]);
+		const auto y0 = std::max(cell_coord(box.min.y - max_radius, cell_size), occupied[1]), y1 = std::min(cell_coord(box.max.y + max_radius, cell_size), occupied[4]);
+		const auto z0 = std::max(cell_coord(box.min.z - max_radius, cell_size), occupied[2]), z1 = std::min(cell_coord(box.max.z + max_radius, cell_size), occupied[5]);
+		if (x0 > x1 || y0 > y1 || z0 > z1)
+			return;
+
+		// Covers more cells than there are bodies, the bodies are fewer lookups
+		const auto num_cells = static_cast<double>(x1 - x0 + 1) * static_cast<double>(y1 - y0 + 1) * static_cast<double>(z1 - z0 + 1);
+		if (num_cells > static_cast<double>(filled_cells))
+		{
+			for (const auto& e : entries)
+				visitor(query, e);
+			return;
+		}
+
+		for (auto z = z0; z <= z1; ++z)
+		{
+			for (auto y = y0; y <= y1; ++y)
+			{
+				for (auto x = x0; x <= x1; ++x)
+				{
+					const auto cell = cells.find(pack_cell(x, y, z));
+					if (cell == cells.end())
+						continue;
+
+					for (const auto i : cell->second)
+						visitor(query, entries[i]);
+				}
+			}
+		}
+		return;
+	}
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const auto& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!overlaps(node.box, box))
+			continue;
+
+		if (node.left < 0)
+		{
+			visitor(query, entries[node.entry]);
+		}
+		else
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+void fen::SpatialIndex::configure(const Kind kind_, const float size)
+{
+	assert(size > 0.0f);
+
+	for (std::uint32_t i = 0; i < entries.size(); ++i)
+		unlink(i);
+
+	kind = kind_;
+	if (kind == Kind::HashGrid)
+		cell_size = size;
+	else
+		margin = size;
+
+	cells.clear();
+	max_radius = 0.0f;
+	occupied = empty_bounds;
+	bound_counts = {};
+	stale_bounds = false;
+	for (std::uint32_t i = 0; i < entries.size(); ++i)
+		link(i);
+}
+
+void fen::SpatialIndex::update(const ChangeTracker& changes)
+{
+	const auto& c = changes.get(Component::ID<SpatialBody>());
+
+	// A body removed and added again in the same frame comes back as a new one
+	for (const auto id : c.removed)
+		remove(id);
+	for (const auto comp : c.added)
+	{
+		if (comp != nullptr && comp->get_owner() != nullptr)
+			insert(comp->get_owner()->get_id(), static_cast<const SpatialBody*>(comp));
+	}
+	for (const auto comp : c.changed)
+	{
+		if (comp != nullptr && comp->get_owner() != nullptr)
+			move(comp->get_owner()->get_id(), static_cast<const SpatialBody*>(comp));
+	}
+
+	if (kind != Kind::HashGrid)
+		return;
+
+	if (stale_bounds)
+		recompute_bounds();
+	if (cells.size() > 2 * filled_cells + 64)
+		std::erase_if(cells, [](const auto& cell) { return cell.second.empty(); });
+}
+
+void fen::SpatialIndex::insert(const EntityId id, const SpatialBody* body)
+{
+	const auto index = static_cast<std::uint32_t>(entries.size());
+	entries.push_back({ id, body, body->get_position(), body->get_radius() });
+	entry_cells.push_back(0);
+	cell_slots.push_back(0);
+	entry_leaves.push_back(-1);
+	slots[id] = index;
+
+	link(index);
+}
+
+void fen::SpatialIndex::move(const EntityId id, const SpatialBody* body)
+{
+	const auto slot = slots.find(id);
+	if (slot == slots.end())
+		return;
+
+	const auto index = slot->second;
+	auto& e = entries[index];
+
+	// Still in its cell with the same radius, or inside its enlarged box: only the entry changes
+	if (kind == Kind::HashGrid)
+	{
+		if (cell_of(body->get_position()) == entry_cells[index] && body->get_radius() == e.radius)
+		{
+			e.position = body->get_position();
+			return;
+		}
+
+		// Leaves the bounds as it was linked
+		unlink(index);
+		e.position = body->get_position();
+		e.radius = body->get_radius();
+		link(index);
+		return;
+	}
+
+	e.position = body->get_position();
+	e.radius = body->get_radius();
+	if (contains(nodes[entry_leaves[index]].box, bounds(e.position, e.radius)))
+		return;
+
+	unlink(index);
+	link(index);
+}
+
+void fen::SpatialIndex::remove(const EntityId id)
+{
+	const auto slot = slots.find(id);
+	if (slot == slots.end())
+		return;
+
+	const auto index = slot->second;
+	slots.erase(slot);
+	unlink(index);
+
+	// The last entry takes its place
+	const auto last = static_cast<std::uint32_t>(entries.size() - 1);
+	if (index != last)
+	{
+		entries[index] = entries[last];
+		entry_cells[index] = entry_cells[last];
+		cell_slots[index] = cell_slots[last];
+		entry_leaves[index] = entry_leaves[last];
+		slots[entries[index].id] = index;
+
+		if (kind == Kind::HashGrid)
+			cells[entry_cells[index]][cell_slots[index]] = index;
+		else
+			nodes[entry_leaves[index]].entry = index;
+	}
+
+	entries.pop_back();
+	entry_cells.pop_back();
+	cell_slots.pop_back();
+	entry_leaves.pop_back();
+}
+
+void fen::SpatialIndex::link(const std::uint32_t index)
+{
+	const auto& e = entries[index];
+
+	if (kind == Kind::HashGrid)
+	{
+		const auto cell = cell_of(e.position);
+		auto& members = cells[cell];
+		if (members.empty())
+			++filled_cells;
+
+		entry_cells[index] = cell;
+		cell_slots[index] = static_cast<std::uint32_t>(members.size());
+		members.push_back(index);
+		add_bounds(cell, e.radius);
+		return;
+	}
+
+	const auto leaf = new_node();
+	nodes[leaf].box = bounds(e.position, e.radius + margin);
+	nodes[leaf].entry = index;
+	entry_leaves[index] = leaf;
+	insert_leaf(leaf);
+}
+
+void fen::SpatialIndex::unlink(const std::uint32_t index)
+{
+	if (kind == Kind::HashGrid)
+	{
+		const auto cell = cells.find(entry_cells[index]);
+		assert(cell != cells.end());
+
+		auto& members = cell->second;
+		const auto slot = cell_slots[index];
+		members[slot] = members.back();
+		cell_slots[members[slot]] = slot;
+		members.pop_back();
+
+		if (members.empty())
+			--filled_cells;
+		remove_bounds(entry_cells[index], entries[index].radius);
+		return;
+	}
+
+	const auto leaf = entry_leaves[index];
+	remove_leaf(leaf);
+	free_nodes.push_back(leaf);
+	entry_leaves[index] = -1;
+}
+
+std::uint64_t fen::SpatialIndex::cell_of(const Vec3& p) const noexcept
+{
+	return pack_cell(cell_coord(p.x, cell_size), cell_coord(p.y, cell_size), cell_coord(p.z, cell_size));
+}
+
+void fen::SpatialIndex::add_bounds(const std::uint64_t cell, const float radius)
+{
+	const auto extend = [this](const std::size_t bound, const bool beyond, const bool on)
+	{
+		if (beyond)
+			bound_counts[bound] = 1;
+		else if (on)
+			++bound_counts[bound];
+	};
+
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		const auto c = cell_axis(cell, axis);
+		extend(axis, c < occupied[axis], c == occupied[axis]);
+		extend(axis + 3, c > occupied[axis + 3], c == occupied[axis + 3]);
+		occupied[axis] = std::min(occupied[axis], c);
+		occupied[axis + 3] = std::max(occupied[axis + 3], c);
+	}
+
+	extend(6, radius > max_radius, radius == max_radius);
+	max_radius = std::max(max_radius, radius);
+}
+
+void fen::SpatialIndex::remove_bounds(const std::uint64_t cell, const float radius)
+{
+	// A bound already left empty stays at 0 until recomputed
+	const auto leave = [this](const std::size_t bound, const bool on)
+	{
+		if (on && bound_counts[bound] > 0 && --bound_counts[bound] == 0)
+			stale_bounds = true;
+	};
+
+	for (unsigned axis = 0; axis < 3; ++axis)
+	{
+		const auto c = cell_axis(cell, axis);
+		leave(axis, c == occupied[axis]);
+		leave(axis + 3, c == occupied[axis + 3]);
+	}
+	leave(6, radius == max_radius);
+}
+
+void fen::SpatialIndex::recompute_bounds()
+{
+	max_radius = 0.0f;
+	occupied = empty_bounds;
+	bound_counts = {};
+	stale_bounds = false;
+	for (std::uint32_t i = 0; i < entries.size(); ++i)
+		add_bounds(entry_cells[i], entries[i].radius);
+}
+
+std::int32_t fen::SpatialIndex::new_node()
+{
+	if (!free_nodes.empty())
+	{
+		const auto node = free_nodes.back();
+		free_nodes.pop_back();
+		nodes[node] = {};
+		return node;
+	}
+
+	nodes.emplace_back();
+	return static_cast<std::int32_t>(nodes.size() - 1);
+}
+
+void fen::SpatialIndex::insert_leaf(const std::int32_t leaf)
+{
+	if (root < 0)
+	{
+		root = leaf;
+		nodes[leaf].parent = -1;
+		return;
+	}
+
+	// Walks down to the sibling that grows the total box area the least
+	const auto box = nodes[leaf].box;
+	auto sibling = root;
+	while (nodes[sibling].left >= 0)
+	{
+		const auto& n = nodes[sibling];
+		const float combined = area(merge(n.box, box));
+
+		// Cost of making a new parent here, and the least cost of going down each child
+		const float here = 2.0f * combined;
+		const float inherited = 2.0f * (combined - area(n.box));
+
+		const auto child_cost = [&](const std::int32_t child)
+		{
+			const auto& c = nodes[child];
+			const float merged = area(merge(c.box, box));
+			return c.left < 0 ? merged + inherited : merged - area(c.box) + inherited;
+		};
+
+		const float left = child_cost(n.left);
+		const float right = child_cost(n.right);
+		if (here < left && here < right)
+			break;
+
+		sibling = left < right ? n.left : n.right;
+	}
+
+	const auto old_parent = nodes[sibling].parent;
+	const auto parent = new_node();
+	nodes[parent].parent = old_parent;
+	nodes[parent].box = merge(nodes[sibling].box, box);
+	nodes[parent].left = sibling;
+	nodes[parent].right = leaf;
+	nodes[sibling].parent = parent;
+	nodes[leaf].parent = parent;
+
+	if (old_parent < 0)
+		root = parent;
+	else if (nodes[old_parent].left == sibling)
+		nodes[old_parent].left = parent;
+	else
+		nodes[old_parent].right = parent;
+
+	for (auto n = old_parent; n >= 0; n = nodes[n].parent)
+		nodes[n].box = merge(nodes[nodes[n].left].box, nodes[nodes[n].right].box);
+}
+
+void fen::SpatialIndex::remove_leaf(const std::int32_t leaf)
+{
+	if (leaf == root)
+	{
+		root = -1;
+		return;
+	}
+
+	// The sibling takes the place of the parent
+	const auto parent = nodes[leaf].parent;
+	const auto grandparent = nodes[parent].parent;
+	const auto sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	nodes[sibling].parent = grandparent;
+	if (grandparent < 0)
+		root = sibling;
+	else if (nodes[grandparent].left == parent)
+		nodes[grandparent].left = sibling;
+	else
+		nodes[grandparent].right = sibling;
+	free_nodes.push_back(parent);
+
+	for (auto n = grandparent; n >= 0; n = nodes[n].parent)
+		nodes[n].box = merge(nodes[nodes[n].left].box, nodes[nodes[n].right].box);
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "change_tracker.h"
+#include "component.h"
+#include "slab_heap.h"
+
+namespace fen
+{
+
+struct Vec3
+{
+	float x{ 0.0f };
+	float y{ 0.0f };
+	float z{ 0.0f };
+};
+
+struct Aabb
+{
+	Vec3 min;
+	Vec3 max;
+};
+
+struct Sphere
+{
+	Vec3 center;
+	float radius{ 0.0f };
+};
+
+/**
+ * \brief Position and extent of an entity in the spatial index of its world. The index is updated at the end of
+ * the frame from the change sets, so write it through the setters, which mark it as changed. Never updated, it sleeps
+ * right after Init
+ */
+class SpatialBody final : public Component
+{
+public:
+
+	void set_position(const Vec3& position_) { position = position_; mark_changed(); }
+	void set_radius(const float radius_) { radius = radius_; mark_changed(); }
+
+	[[nodiscard]] const Vec3& get_position() const noexcept { return position; }
+	[[nodiscard]] float get_radius() const noexcept { return radius; }
+
+	void Destroy() override {}
+
+protected:
+
+	void Init() override { sleep(); }
+	void Update(double) override {}
+
+private:
+
+	Vec3 position;
+	float radius{ 0.0f };
+};
+
+/**
+ * \brief A SpatialBody as the index saw it at the end of the previous frame
+ */
+struct SpatialEntry
+{
+	EntityId id;
+	const SpatialBody* body;
+	Vec3 position;
+	float radius;
+};
+
+/**
+ * \brief Proximity queries over the SpatialBody components of a world. See Engine::get_spatial_index.\n
+ * Updated after every step, only for the bodies added, changed or removed during it. Queries see the bodies as of the
+ * end of the previous frame and do not modify the index, so they can run from parallel updates
+ */
+class SpatialIndex
+{
+	friend class Engine;
+
+public:
+
+	/**
+	 * \brief HashGrid buckets the bodies in cubic cells, best when they have similar sizes and spread evenly.
+	 * LooseBvh is a tree of boxes enlarged by a margin, so small moves do not touch the tree. Best for uneven
+	 * densities and sizes
+	 */
+	enum class Kind : std::uint8_t { HashGrid, LooseBvh };
+
+	/**
+	 * \brief Calls func(const SpatialEntry&) for every body whose sphere touches the query sphere
+	 */
+	template<typename Func>
+	void for_each_in_radius(const Vec3& center, const float radius, Func&& func) const
+	{
+		visit(bounds(center, radius), &radius_filter<Func>, Query{ { center, radius }, &func });
+	}
+
+	/**
+	 * \brief Calls func(const SpatialEntry&) for every body whose bounding box overlaps box
+	 */
+	template<typename Func>
+	void for_each_in_box(const Aabb& box, Func&& func) const
+	{
+		visit(box, &box_filter<Func>, Query{ { {}, 0.0f }, &func, box });
+	}
+
+	/**
+	 * \brief Runs a batch of radius queries. The hits of query i are hits[offsets[i], offsets[i + 1])
+	 */
+	void query_radius(std::span<const Sphere> queries, std::vector<SpatialEntry>& hits, std::vector<std::uint32_t>& offsets) const;
+
+	/**
+	 * \brief Runs a batch of box queries. The hits of query i are hits[offsets[i], offsets[i + 1])
+	 */
+	void query_box(std::span<const Aabb> queries, std::vector<SpatialEntry>& hits, std::vector<std::uint32_t>& offsets) const;
+
+	[[nodiscard]] std::size_t size() const noexcept { return entries.size(); }
+	[[nodiscard]] Kind get_kind() const noexcept { return kind; }
+
+private:
+
+	struct Query
+	{
+		Sphere sphere;
+		const void* func;
+		Aabb box{};
+	};
+
+	using Visitor = void(*)(const Query&, const SpatialEntry&);
+
+	template<typename Func>
+	static void radius_filter(const Query& q, const SpatialEntry& e)
+	{
+		const float dx = e.position.x - q.sphere.center.x;
+		const float dy = e.position.y - q.sphere.center.y;
+		const float dz = e.position.z - q.sphere.center.z;
+		const float r = q.sphere.radius + e.radius;
+		if (dx * dx + dy * dy + dz * dz <= r * r)
+			(*static_cast<std::remove_reference_t<Func>*>(const_cast<void*>(q.func)))(e);
+	}
+
+	template<typename Func>
+	static void box_filter(const Query& q, const SpatialEntry& e)
+	{
+		if (overlaps(bounds(e.position, e.radius), q.box))
+			(*static_cast<std::remove_reference_t<Func>*>(const_cast<void*>(q.func)))(e);
+	}
+
+	[[nodiscard]] static Aabb bounds(const Vec3& center, const float radius) noexcept
+	{
+		return { { center.x - radius, center.y - radius, center.z - radius }, { center.x + radius, center.y + radius, center.z + radius } };
+	}
+
+	[[nodiscard]] static bool overlaps(const Aabb& a, const Aabb& b) noexcept
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x && a.min.y <= b.max.y && a.max.y >= b.min.y && a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+
+	// Calls visitor for the entries whose structure overlaps box. The visitor does the exact test
+	void visit(const Aabb& box, Visitor visitor, const Query& query) const;
+
+	/**
+	 * \brief Switches the structure and rebuilds it from the current bodies
+	 * \param size Cell size of the HashGrid, margin of the LooseBvh boxes
+	 */
+	void configure(Kind kind, float size);
+
+	// Applies the changes published by the last step
+	void update(const ChangeTracker& changes);
+
+	void insert(EntityId id, const SpatialBody* body);
+	void move(EntityId id, const SpatialBody* body);
+	void remove(EntityId id);
+
+	// Structure of one entry
+	void link(std::uint32_t index);
+	void unlink(std::uint32_t index);
+
+	template<typename T>
+	using List = SlabVector<T, MemoryTag::Spatial>;
+
+	template<typename K, typename V>
+	using Map = std::unordered_map<K, V, std::hash<K>, std::equal_to<K>, SlabAllocator<std::pair<const K, V>, MemoryTag::Spatial>>;
+
+	Kind kind{ Kind::HashGrid };
+	float cell_size{ 4.0f };
+	float margin{ 0.5f };
+
+	List<SpatialEntry> entries;
+	Map<EntityId, std::uint32_t> slots;
+
+	// HashGrid: entries by the cell of their center, and each entry's cell and place in it. Emptied cells are kept for
+	// the bodies coming back, and dropped at the end of an update once they outnumber the filled ones.
+	// Queries are widened by the largest radius and clipped to the occupied cells, min xyz then max xyz. bound_counts
+	// holds how many entries sit on each of those bounds, the largest radius last, and the bounds are recomputed at the
+	// end of the update that leaves one of them empty
+	[[nodiscard]] std::uint64_t cell_of(const Vec3& p) const noexcept;
+	void add_bounds(std::uint64_t cell, float radius);
+	void remove_bounds(std::uint64_t cell, float radius);
+	void recompute_bounds();
+
+	Map<std::uint64_t, List<std::uint32_t>> cells;
+	std::size_t filled_cells{ 0 };
+	List<std::uint64_t> entry_cells;
+	List<std::uint32_t> cell_slots;
+	float max_radius{ 0.0f };
+	static constexpr auto lowest = std::numeric_limits<std::int64_t>::lowest();
+	static constexpr auto highest = std::numeric_limits<std::int64_t>::max();
+	static constexpr std::array<std::int64_t, 6> empty_bounds{ highest, highest, highest, lowest, lowest, lowest };
+	std::array<std::int64_t, 6> occupied{ empty_bounds };
+	std::array<std::uint32_t, 7> bound_counts{};
+	bool stale_bounds{ false };
+
+	// LooseBvh: leaves hold an entry and its enlarged box
+	struct Node
+	{
+		Aabb box;
+		std::int32_t parent{ -1 };
+		std::int32_t left{ -1 };
+		std::int32_t right{ -1 };
+		std::uint32_t entry{ 0 };
+	};
+
+	[[nodiscard]] std::int32_t new_node();
+	void insert_leaf(std::int32_t leaf);
+	void remove_leaf(std::int32_t leaf);
+
+	List<Node> nodes;
+	List<std::int32_t> free_nodes;
+	List<std::int32_t> entry_leaves;
+	std::int32_t root{ -1 };
+};
+
+} // namespace fen
@@ -0,0 +1,15 @@
+#include "staged_region.h"
+
+#include <cassert>
+
+fen::StagedRegion::StagedRegion(Engine& world_, const RegionId region_) : world(&world_), region(region_)
+{
+	assert(region != no_region);
+}
+
+fen::Entity& fen::StagedRegion::add_entity()
+{
+	auto& e = entities.emplace_back(0, world);
+	e.staged = true;
+	return e;
+}
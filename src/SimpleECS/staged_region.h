@@ -0,0 +1,45 @@
+#pragma once
+
+#include <deque>
+
+#include "entity.h"
+
+namespace fen
+{
+class Engine;
+
+/**
+ * \brief Entities built outside the world, usually by a loading thread, and handed to it with Engine::stage.\n
+ * Building a region does not touch the world: components are created and configured here, and the world
+ * initializes them once the entities are committed. A region is used by a single thread at a time
+ */
+class StagedRegion
+{
+	friend class Engine;
+
+public:
+
+	/**
+	 * \param world_ World the entities will be committed to
+	 * \param region_ Region the entities belong to. Engine::unload_region removes them together. Cannot be no_region
+	 */
+	StagedRegion(Engine& world_, RegionId region_);
+
+	/**
+	 * \brief Creates an entity of the region. It has no id until it is committed
+	 */
+	[[nodiscard]] Entity& add_entity();
+
+	[[nodiscard]] RegionId get_region() const noexcept { return region; }
+	[[nodiscard]] std::size_t size() const noexcept { return entities.size(); }
+
+private:
+
+	Engine* world;
+	RegionId region;
+
+	// A deque keeps the references handed out by add_entity valid
+	std::deque<Entity> entities;
+};
+
+} // namespace fen
@@ -0,0 +1,94 @@
+#include "task.h"
+
+#include <array>
+#include <new>
+
+#include "component.h"
+
+namespace
+{
+	constexpr std::size_t class_granularity = 64;
+	constexpr std::size_t num_classes = 16; // Frames up to 1 KiB are pooled
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct ThreadFramePool
+	{
+		std::array<FreeBlock*, num_classes> free_lists{};
+
+		~ThreadFramePool()
+		{
+			for (auto block : free_lists)
+			{
+				while (block != nullptr)
+				{
+					const auto next = block->next;
+					::operator delete(block);
+					block = next;
+				}
+			}
+		}
+	};
+
+	// Per thread so worlds running on different threads do not contend. Every block is an independent allocation,
+	// so a frame freed on another thread just moves to that thread cache
+	thread_local ThreadFramePool pool;
+
+	constexpr std::size_t class_of(const std::size_t size) { return (size + class_granularity - 1) / class_granularity - 1; }
+}
+
+void* fen::TaskFramePool::allocate(const std::size_t size)
+{
+	const auto c = class_of(size);
+	if (c >= num_classes)
+		return ::operator new(size);
+
+	if (auto block = pool.free_lists[c]; block != nullptr)
+	{
+		pool.free_lists[c] = block->next;
+		return block;
+	}
+
+	return ::operator new((c + 1) * class_granularity);
+}
+
+void fen::TaskFramePool::deallocate(void* ptr, const std::size_t size) noexcept
+{
+	const auto c = class_of(size);
+	if (c >= num_classes)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	const auto block = static_cast<FreeBlock*>(ptr);
+	block->next = pool.free_lists[c];
+	pool.free_lists[c] = block;
+}
+
+fen::TaskPromise::~TaskPromise()
+{
+	cancel();
+}
+
+void fen::TaskPromise::cancel() noexcept
+{
+	cancelled = true;
+
+	if (comp == nullptr)
+		return;
+
+	if (prev != nullptr)
+		prev->next = next;
+	else
+		comp->tasks = next;
+
+	if (next != nullptr)
+		next->prev = prev;
+
+	comp = nullptr;
+	prev = next = nullptr;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <utility>
+
+namespace fen
+{
+class Component;
+class TaskScheduler;
+
+/**
+ * \brief Size class allocator for coroutine frames. Freed frames are cached per thread and reused by the next coroutine
+ * of the same size class, so starting behaviours does not reach the heap once the world is warm
+ */
+class TaskFramePool
+{
+public:
+	[[nodiscard]] static void* allocate(std::size_t size);
+	static void deallocate(void* ptr, std::size_t size) noexcept;
+};
+
+class TaskPromise
+{
+	friend Component;
+	friend TaskScheduler;
+
+public:
+
+	[[nodiscard]] static void* operator new(const std::size_t size) { return TaskFramePool::allocate(size); }
+	static void operator delete(void* ptr, const std::size_t size) noexcept { TaskFramePool::deallocate(ptr, size); }
+
+	~TaskPromise();
+
+	[[nodiscard]] std::coroutine_handle<TaskPromise> handle() noexcept { return std::coroutine_handle<TaskPromise>::from_promise(*this); }
+
+	[[nodiscard]] class Task get_return_object() noexcept;
+
+	// Does not run until the component starts it
+	[[nodiscard]] std::suspend_always initial_suspend() const noexcept { return {}; }
+
+	// The frame frees itself when the behaviour finishes
+	[[nodiscard]] std::suspend_never final_suspend() const noexcept { return {}; }
+
+	void return_void() const noexcept {}
+	void unhandled_exception() const noexcept { std::terminate(); }
+
+	[[nodiscard]] bool is_cancelled() const noexcept { return cancelled; }
+	[[nodiscard]] TaskScheduler* get_scheduler() const noexcept { return scheduler; }
+
+private:
+
+	// Unlinks this task from its component. The frame stays alive until the scheduler drops it
+	void cancel() noexcept;
+
+	TaskScheduler* scheduler{ nullptr };
+
+	// Intrusive list of the tasks started by the same component
+	Component* comp{ nullptr };
+	TaskPromise* prev{ nullptr };
+	TaskPromise* next{ nullptr };
+
+	bool cancelled{ false };
+};
+
+/**
+ * \brief Coroutine return type of a component behaviour. Start it with Component::start.\n
+ * Inside a behaviour, co_await Engine::next_frame(), Engine::delay(seconds) or an Event
+ */
+class Task
+{
+	friend Component;
+
+public:
+
+	using promise_type = TaskPromise;
+
+	explicit Task(std::coroutine_handle<TaskPromise> h) noexcept : handle(h) {}
+	Task(Task&& t) noexcept : handle(std::exchange(t.handle, nullptr)) {}
+	Task(const Task& t) = delete;
+	Task& operator=(const Task& t) = delete;
+	Task& operator=(Task&& t) = delete;
+
+	// A task that was never started is destroyed with its frame
+	~Task()
+	{
+		if (handle)
+			handle.destroy();
+	}
+
+private:
+
+	std::coroutine_handle<TaskPromise> handle;
+};
+
+inline Task TaskPromise::get_return_object() noexcept
+{
+	return Task(handle());
+}
+
+} // namespace fen
@@ -0,0 +1,72 @@
+#include "task_scheduler.h"
+
+#include <algorithm>
+
+fen::TaskScheduler::~TaskScheduler()
+{
+	for (const auto& [f, h] : next_frame)
+		h.destroy();
+
+	while (!delayed.empty())
+	{
+		delayed.top().h.destroy();
+		delayed.pop();
+	}
+
+	for (const auto h : ready)
+		h.destroy();
+}
+
+void fen::TaskScheduler::run(const double time)
+{
+	// Behaviours that waited on a previous frame. The ones suspended during this frame update stay
+	const auto first_new = std::find_if(next_frame.begin(), next_frame.end(), [this](const auto& p) { return p.first >= frame; });
+	for (auto it = next_frame.begin(); it != first_new; ++it)
+		resuming.push_back(it->second);
+	next_frame.erase(next_frame.begin(), first_new);
+
+	while (!delayed.empty() && delayed.top().deadline <= time)
+	{
+		resuming.push_back(delayed.top().h);
+		delayed.pop();
+	}
+
+	// Events signaled while resuming release their waiters in this same run
+	do
+	{
+		resuming.insert(resuming.end(), ready.begin(), ready.end());
+		ready.clear();
+
+		for (const auto h : resuming)
+			resume(h);
+
+		resuming.clear();
+	}
+	while (!ready.empty());
+
+	++frame;
+}
+
+void fen::TaskScheduler::resume(const Handle h)
+{
+	if (h.promise().is_cancelled())
+		h.destroy();
+	else
+		h.resume();
+}
+
+fen::Event::~Event()
+{
+	for (const auto h : waiters)
+		h.destroy();
+}
+
+void fen::Event::signal()
+{
+	// Swapped out first, a resumed behaviour may wait on this event again
+	std::vector<TaskScheduler::Handle> released;
+	released.swap(waiters);
+
+	for (const auto h : released)
+		h.promise().get_scheduler()->schedule_ready(h);
+}
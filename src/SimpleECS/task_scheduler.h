@@ -0,0 +1,144 @@
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "task.h"
+
+namespace fen
+{
+
+/**
+ * \brief Holds the suspended component behaviours and resumes only the ones that are ready.
+ * Run once per frame by the engine after the update cycle
+ */
+class TaskScheduler
+{
+public:
+
+	using Handle = std::coroutine_handle<TaskPromise>;
+
+	TaskScheduler() = default;
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler& other) = delete;
+	TaskScheduler& operator=(const TaskScheduler& other) = delete;
+	TaskScheduler(TaskScheduler&& other) = delete;
+	TaskScheduler& operator=(TaskScheduler&& other) = delete;
+
+	/**
+	 * \brief Resumes h on the first run of a later frame
+	 */
+	void schedule_next_frame(Handle h) { next_frame.emplace_back(frame, h); }
+
+	/**
+	 * \brief Resumes h on the first run where the time reaches deadline
+	 */
+	void schedule_at(double deadline, Handle h) { delayed.push({ deadline, seq++, h }); }
+
+	/**
+	 * \brief Resumes h on the current run, or the next one if it is called outside of a run
+	 */
+	void schedule_ready(Handle h) { ready.push_back(h); }
+
+	/**
+	 * \brief Resumes every ready behaviour
+	 * \param time engine time in seconds
+	 */
+	void run(double time);
+
+	/**
+	 * \return Number of suspended behaviours waiting on the scheduler (does not count the ones waiting on an Event)
+	 */
+	[[nodiscard]] std::size_t size() const noexcept { return next_frame.size() + delayed.size() + ready.size(); }
+
+private:
+
+	// Cancelled behaviours are destroyed instead of resumed
+	static void resume(Handle h);
+
+	struct Delayed
+	{
+		double deadline;
+		std::uint64_t seq; // Keeps FIFO order between equal deadlines
+		Handle h;
+
+		bool operator>(const Delayed& o) const noexcept { return deadline > o.deadline || (deadline == o.deadline && seq > o.seq); }
+	};
+
+	std::vector<std::pair<std::uint32_t, Handle>> next_frame;
+	std::priority_queue<Delayed, std::vector<Delayed>, std::greater<>> delayed;
+	std::vector<Handle> ready;
+	std::vector<Handle> resuming;
+
+	std::uint32_t frame{ 0 };
+	std::uint64_t seq{ 0 };
+};
+
+/**
+ * \brief Awaitable returned by Engine::next_frame
+ */
+struct NextFrameAwaiter
+{
+	TaskScheduler* scheduler;
+
+	[[nodiscard]] bool await_ready() const noexcept { return false; }
+	void await_suspend(const TaskScheduler::Handle h) const { scheduler->schedule_next_frame(h); }
+	void await_resume() const noexcept {}
+};
+
+/**
+ * \brief Awaitable returned by Engine::delay
+ */
+struct DelayAwaiter
+{
+	TaskScheduler* scheduler;
+	double deadline;
+
+	[[nodiscard]] bool await_ready() const noexcept { return false; }
+	void await_suspend(const TaskScheduler::Handle h) const { scheduler->schedule_at(deadline, h); }
+	void await_resume() const noexcept {}
+};
+
+/**
+ * \brief Behaviours that co_await an Event are resumed in the scheduler run after signal is called.\n
+ * Destroying an Event destroys the behaviours still waiting on it
+ */
+class Event
+{
+public:
+
+	Event() = default;
+	~Event();
+
+	Event(const Event& other) = delete;
+	Event& operator=(const Event& other) = delete;
+
+	/**
+	 * \brief Releases every behaviour waiting on this event
+	 */
+	void signal();
+
+	[[nodiscard]] bool has_waiters() const noexcept { return !waiters.empty(); }
+
+	struct Awaiter
+	{
+		Event* event;
+
+		[[nodiscard]] bool await_ready() const noexcept { return false; }
+		void await_suspend(const TaskScheduler::Handle h) const { event->waiters.push_back(h); }
+		void await_resume() const noexcept {}
+	};
+
+	[[nodiscard]] Awaiter operator co_await() noexcept { return { this }; }
+
+private:
+
+	std::vector<TaskScheduler::Handle> waiters;
+};
+
+} // namespace fen
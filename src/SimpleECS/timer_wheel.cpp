@@ -0,0 +1,139 @@
+#include "timer_wheel.h"
+
+#include <cassert>
+
+#include "component.h"
+
+namespace
+{
+	constexpr std::uint8_t overflow_level = fen::TimerWheel::num_levels;
+}
+
+void fen::TimerWheel::insert(Component* comp, const std::uint64_t deadline)
+{
+	assert(comp->timer.wheel == nullptr);
+
+	// A deadline that already passed wakes up on the next advance
+	comp->timer.deadline = deadline > now_ ? deadline : now_ + 1;
+	comp->timer.wheel = this;
+	place(comp);
+	++count;
+}
+
+void fen::TimerWheel::remove(Component* comp)
+{
+	assert(comp->timer.wheel == this);
+
+	auto& slot = slot_of(comp);
+	auto& node = comp->timer;
+
+	if (node.prev != nullptr)
+		node.prev->timer.next = node.next;
+	else
+		slot.head = node.next;
+
+	if (node.next != nullptr)
+		node.next->timer.prev = node.prev;
+	else
+		slot.tail = node.prev;
+
+	node.prev = node.next = nullptr;
+	node.wheel = nullptr;
+	--count;
+}
+
+void fen::TimerWheel::advance(const std::uint64_t time, SlabVector<Component*, MemoryTag::Queues>& expired)
+{
+	while (now_ < time)
+	{
+		// Nothing to wake, jump straight to the target
+		if (count == 0)
+		{
+			now_ = time;
+			return;
+		}
+
+		++now_;
+
+		// Cascade from the highest level so the entries can fall through the lower ones in the same step
+		for (unsigned level = num_levels - 1; level > 0; --level)
+		{
+			const auto shift = level * slot_bits;
+			if ((now_ & ((std::uint64_t{ 1 } << shift) - 1)) != 0)
+				continue;
+
+			if (level == num_levels - 1)
+				cascade(overflow);
+
+			cascade(wheel[level][(now_ >> shift) & (num_slots - 1)]);
+		}
+
+		auto& slot = wheel[0][now_ & (num_slots - 1)];
+		for (auto comp = slot.head; comp != nullptr;)
+		{
+			const auto next = comp->timer.next;
+			comp->timer.wheel = nullptr;
+			comp->timer.prev = comp->timer.next = nullptr;
+			expired.push_back(comp);
+			--count;
+			comp = next;
+		}
+		slot = Slot{};
+	}
+}
+
+void fen::TimerWheel::place(Component* comp)
+{
+	const auto deadline = comp->timer.deadline;
+
+	// The level is the lowest one in which deadline and now share the block of the level above
+	for (std::uint8_t level = 0; level < num_levels; ++level)
+	{
+		const auto shift = (level + 1) * slot_bits;
+		if ((deadline >> shift) == (now_ >> shift))
+		{
+			const auto slot_idx = static_cast<std::uint8_t>((deadline >> (level * slot_bits)) & (num_slots - 1));
+			push(wheel[level][slot_idx], comp, level, slot_idx);
+			return;
+		}
+	}
+
+	push(overflow, comp, overflow_level, 0);
+}
+
+void fen::TimerWheel::push(Slot& slot, Component* comp, const std::uint8_t level, const std::uint8_t slot_idx)
+{
+	auto& node = comp->timer;
+	node.level = level;
+	node.slot = slot_idx;
+	node.prev = slot.tail;
+	node.next = nullptr;
+
+	if (slot.tail != nullptr)
+		slot.tail->timer.next = comp;
+	else
+		slot.head = comp;
+	slot.tail = comp;
+}
+
+void fen::TimerWheel::cascade(Slot& slot)
+{
+	// Detach first, place may push back into the same slot
+	auto comp = slot.head;
+	slot = Slot{};
+
+	while (comp != nullptr)
+	{
+		const auto next = comp->timer.next;
+		place(comp);
+		comp = next;
+	}
+}
+
+fen::TimerWheel::Slot& fen::TimerWheel::slot_of(const Component* comp)
+{
+	if (comp->timer.level == overflow_level)
+		return overflow;
+
+	return wheel[comp->timer.level][comp->timer.slot];
+}
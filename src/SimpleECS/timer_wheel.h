@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "slab_heap.h"
+
+namespace fen
+{
+class Component;
+
+/**
+ * \brief Hierarchical timing wheel holding sleeping components until their deadline.\n
+ * Insertion and removal are O(1) and never allocate, every slot is a list linked through the components.
+ * Advancing the wheel only touches the slots that expire or cascade.
+ * The unit of the deadlines is decided by the owner (frames or milliseconds)
+ */
+class TimerWheel
+{
+public:
+
+	static constexpr unsigned slot_bits = 6;
+	static constexpr unsigned num_slots = 1u << slot_bits;
+	static constexpr unsigned num_levels = 4;
+
+	/**
+	 * \brief Adds a component that wakes up when the wheel reaches deadline. Deadlines in the past expire on the next advance
+	 */
+	void insert(Component* comp, std::uint64_t deadline);
+
+	/**
+	 * \brief Removes a component before its deadline. The component must be in this wheel
+	 */
+	void remove(Component* comp);
+
+	/**
+	 * \brief Moves the wheel up to time and appends every expired component to expired
+	 */
+	void advance(std::uint64_t time, SlabVector<Component*, MemoryTag::Queues>& expired);
+
+	[[nodiscard]] std::uint64_t now() const noexcept { return now_; }
+	[[nodiscard]] std::size_t size() const noexcept { return count; }
+
+private:
+
+	// Components in insertion order, linked by their TimerNode
+	struct Slot
+	{
+		Component* head{ nullptr };
+		Component* tail{ nullptr };
+	};
+
+	void place(Component* comp);
+	void push(Slot& slot, Component* comp, std::uint8_t level, std::uint8_t slot_idx);
+	void cascade(Slot& slot);
+
+	[[nodiscard]] Slot& slot_of(const Component* comp);
+
+	std::array<std::array<Slot, num_slots>, num_levels> wheel{};
+
+	// Deadlines that do not fit in the highest level. Rechecked every time the highest level cascades
+	Slot overflow;
+
+	std::uint64_t now_{ 0 };
+	std::size_t count{ 0 };
+};
+
+} // namespace fen
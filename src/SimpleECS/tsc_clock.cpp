@@ -0,0 +1,27 @@
+#include "tsc_clock.h"
+
+#if FEN_HAS_TSC && FEN_PROFILE_TSC
+#include <mutex>
+#include <thread>
+
+void fen::TscClock::calibrate()
+{
+	static std::once_flag calibrated;
+	std::call_once(calibrated, []
+	{
+		using steady = std::chrono::steady_clock;
+
+		const auto t0 = steady::now();
+		const auto c0 = __rdtsc();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		const auto c1 = __rdtsc();
+		const auto t1 = steady::now();
+
+		ns_per_tick = std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(c1 - c0);
+	});
+}
+#else
+void fen::TscClock::calibrate()
+{
+}
+#endif
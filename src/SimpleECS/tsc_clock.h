@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "profiler_config.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FEN_HAS_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#define FEN_HAS_TSC 0
+#endif
+
+namespace fen
+{
+
+/**
+ * \brief std::chrono compatible clock that reads the CPU time stamp counter when FEN_PROFILE_TSC is set. Call calibrate
+ * before the first read, EngineProfiler does it when constructed. The calibration against the steady clock takes 10 ms
+ * and runs once per process.\n
+ * Falls back to the steady clock otherwise, and on architectures without a time stamp counter
+ */
+struct TscClock
+{
+	using rep = std::int64_t;
+	using period = std::nano;
+	using duration = std::chrono::duration<rep, period>;
+	using time_point = std::chrono::time_point<TscClock>;
+	static constexpr bool is_steady = true;
+
+	[[nodiscard]] static time_point now() noexcept
+	{
+#if FEN_HAS_TSC && FEN_PROFILE_TSC
+		return time_point(duration(static_cast<rep>(static_cast<double>(__rdtsc()) * ns_per_tick)));
+#else
+		return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+#endif
+	}
+
+	/**
+	 * \brief Measures the length of a tick. Thread safe, only the first call measures. Does nothing without the counter
+	 */
+	static void calibrate();
+
+#if FEN_HAS_TSC && FEN_PROFILE_TSC
+private:
+
+	// Written once by calibrate, before the threads that read the clock are given the profiler
+	static inline double ns_per_tick{ 0.0 };
+#endif
+};
+
+} // namespace fen
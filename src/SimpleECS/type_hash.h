@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace fen
+{
+
+/**
+ * \brief 32 bit FNV-1a hash. Same result on every compiler and build, usable in constant expressions
+ */
+[[nodiscard]] constexpr std::uint32_t fnv1a(const std::string_view str) noexcept
+{
+	std::uint32_t hash = 2166136261u;
+	for (const char c : str)
+	{
+		hash ^= static_cast<std::uint8_t>(c);
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+namespace detail
+{
+	template<typename T>
+	[[nodiscard]] constexpr std::string_view signature_type_name() noexcept
+	{
+#if defined(_MSC_VER) && !defined(__clang__)
+		constexpr std::string_view sig = __FUNCSIG__;
+		constexpr auto start = sig.find("signature_type_name<") + sizeof("signature_type_name<") - 1;
+		constexpr auto end = sig.rfind(">(void)");
+#else
+		constexpr std::string_view sig = __PRETTY_FUNCTION__;
+		constexpr auto start = sig.find("T = ") + sizeof("T = ") - 1;
+		constexpr auto end = sig.find_first_of(";]", start);
+#endif
+		return sig.substr(start, end - start);
+	}
+
+	[[nodiscard]] constexpr bool is_identifier_char(const char c) noexcept
+	{
+		return c == '_' || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	}
+
+	// Writes name to out in the spelling shared by the compilers, returns its length. out holds at least name.size() chars
+	[[nodiscard]] constexpr std::size_t normalize_type_name(const std::string_view name, char* out) noexcept
+	{
+		constexpr std::string_view keywords[] = { "class ", "struct ", "enum ", "union " };
+		constexpr std::string_view anonymous[] = { "`anonymous namespace'", "(anonymous namespace)", "{anonymous}" };
+		constexpr std::string_view anonymous_out = "(anonymous)";
+
+		std::size_t size = 0;
+		std::size_t i = 0;
+		while (i < name.size())
+		{
+			const auto rest = name.substr(i);
+			const bool token_start = i == 0 || !is_identifier_char(name[i - 1]);
+
+			bool skipped = false;
+			for (const auto keyword : keywords)
+			{
+				if (token_start && rest.starts_with(keyword))
+				{
+					i += keyword.size();
+					skipped = true;
+					break;
+				}
+			}
+			for (const auto spelling : anonymous)
+			{
+				if (!skipped && rest.starts_with(spelling))
+				{
+					for (const char c : anonymous_out)
+						out[size++] = c;
+					i += spelling.size();
+					skipped = true;
+				}
+			}
+			if (skipped)
+				continue;
+
+			// Spaces only separate two identifiers: "unsigned int", but "A<B,C>", "A<B<C>>" and "T*"
+			const char c = name[i++];
+			if (c == ' ' && !(size > 0 && is_identifier_char(out[size - 1]) && i < name.size() && is_identifier_char(name[i])))
+				continue;
+			out[size++] = c;
+		}
+		return size;
+	}
+
+	template<std::size_t N>
+	struct TypeName
+	{
+		char chars[N + 1]{};
+		std::size_t size{ 0 };
+	};
+
+	template<typename T>
+	inline constexpr auto normalized_type_name = []
+	{
+		constexpr auto raw = signature_type_name<T>();
+		TypeName<raw.size()> name;
+		name.size = normalize_type_name(raw, name.chars);
+		return name;
+	}();
+}
+
+/**
+ * \brief Qualified name of T taken from the function signature at compile time. The class, struct, enum and union
+ * keywords and the spaces that do not separate two identifiers are dropped, and anonymous namespaces are spelled
+ * (anonymous), so user types get the same name from MSVC, GCC and Clang.\n
+ * The spelling of standard library types (inline namespaces, default template arguments), of fundamental types like
+ * long long and of non type template arguments still depends on the toolchain
+ */
+template<typename T>
+[[nodiscard]] constexpr std::string_view type_name() noexcept
+{
+	return { detail::normalized_type_name<T>.chars, detail::normalized_type_name<T>.size };
+}
+
+/**
+ * \brief Stable identifier of T, derived from type_name. Safe to store in saved data, also between toolchains as long as
+ * T is not named through the types type_name leaves toolchain specific
+ */
+template<typename T>
+[[nodiscard]] constexpr std::uint32_t type_hash() noexcept
+{
+	return fnv1a(type_name<T>());
+}
+
+} // namespace fen
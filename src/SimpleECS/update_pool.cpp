@@ -0,0 +1,85 @@
+#include "update_pool.h"
+
+namespace
+{
+	thread_local bool parallel_update = false;
+}
+
+fen::UpdatePool::UpdatePool(const unsigned num_threads)
+{
+	threads.reserve(num_threads);
+	for (unsigned i = 0; i < num_threads; ++i)
+		threads.emplace_back(&UpdatePool::work, this);
+}
+
+fen::UpdatePool::~UpdatePool()
+{
+	{
+		std::lock_guard lock(mutex);
+		stop = true;
+	}
+	started.notify_all();
+
+	for (auto& t : threads)
+		t.join();
+}
+
+bool fen::UpdatePool::in_parallel_update() noexcept
+{
+	return parallel_update;
+}
+
+void fen::UpdatePool::run(const std::size_t count_, const Job job_, void* context_)
+{
+	if (count_ == 0)
+		return;
+
+	{
+		std::lock_guard lock(mutex);
+		job = job_;
+		context = context_;
+		count = count_;
+		next.store(0, std::memory_order_relaxed);
+		busy = size();
+		++generation;
+	}
+	started.notify_all();
+
+	drain();
+
+	std::unique_lock lock(mutex);
+	finished.wait(lock, [this] { return busy == 0; });
+	job = nullptr;
+}
+
+void fen::UpdatePool::work()
+{
+	std::uint64_t seen = 0;
+
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		started.wait(lock, [this, seen] { return stop || generation != seen; });
+		if (stop)
+			return;
+
+		seen = generation;
+		lock.unlock();
+
+		drain();
+
+		lock.lock();
+		if (--busy == 0)
+			finished.notify_one();
+	}
+}
+
+void fen::UpdatePool::drain()
+{
+	parallel_update = true;
+
+	for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed))
+		job(context, i);
+
+	parallel_update = false;
+}
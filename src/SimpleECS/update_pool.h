@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fen
+{
+
+/**
+ * \brief Threads of a world that update its double buffered components (see BufferedComponent). The calling thread
+ * takes part in every run, so a pool of n threads runs on n + 1 cores. Does not allocate once created
+ */
+class UpdatePool
+{
+public:
+
+	explicit UpdatePool(unsigned num_threads);
+	~UpdatePool();
+
+	UpdatePool(const UpdatePool& other) = delete;
+	UpdatePool& operator=(const UpdatePool& other) = delete;
+
+	/**
+	 * \brief Calls func(i) for every i in [0, count) on the pool threads and the caller. Returns when all are done
+	 */
+	template<typename Func>
+	void run(const std::size_t count, Func& func)
+	{
+		run(count, [](void* f, const std::size_t i) { (*static_cast<Func*>(f))(i); }, &func);
+	}
+
+	/**
+	 * \return true on the threads running an UpdatePool job, the caller of run included
+	 */
+	[[nodiscard]] static bool in_parallel_update() noexcept;
+
+	[[nodiscard]] unsigned size() const noexcept { return static_cast<unsigned>(threads.size()); }
+
+private:
+
+	using Job = void(*)(void*, std::size_t);
+
+	void run(std::size_t count, Job job, void* context);
+
+	void work();
+
+	// Takes indices of the current job until there are none left
+	void drain();
+
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable started;
+	std::condition_variable finished;
+	std::uint64_t generation{ 0 };
+	unsigned busy{ 0 };
+	bool stop{ false };
+
+	Job job{ nullptr };
+	void* context{ nullptr };
+	std::size_t count{ 0 };
+	std::atomic<std::size_t> next{ 0 };
+};
+
+} // namespace fen
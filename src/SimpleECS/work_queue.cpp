@@ -0,0 +1,116 @@
+#include "work_queue.h"
+
+#include <chrono>
+
+#include "component.h"
+
+void fen::WorkQueue::submit(Step step, const int priority, Component* owner)
+{
+	std::uint32_t slot;
+	if (!free_slots.empty())
+	{
+		slot = free_slots.back();
+		free_slots.pop_back();
+	}
+	else
+	{
+		slot = static_cast<std::uint32_t>(jobs.size());
+		jobs.emplace_back();
+	}
+
+	auto& job = jobs[slot];
+	job.step = std::move(step);
+	job.owner = owner;
+	job.priority = priority;
+	job.alive = true;
+
+	job.prev_owned = no_slot;
+	job.next_owned = no_slot;
+
+	if (owner != nullptr)
+	{
+		job.next_owned = owner->work_head;
+		if (owner->work_head != no_slot)
+			jobs[owner->work_head].prev_owned = slot;
+		owner->work_head = slot;
+	}
+
+	++num_jobs;
+	push(slot, last_frame);
+}
+
+void fen::WorkQueue::cancel(Component* comp)
+{
+	while (comp->work_head != no_slot)
+		release(comp->work_head);
+}
+
+void fen::WorkQueue::run(const double budget, const std::uint32_t frame)
+{
+	using hr_clock = std::chrono::high_resolution_clock;
+
+	last_frame = frame;
+
+	const auto start = hr_clock::now();
+	bool first = true;
+
+	while (!queue.empty() && (first || std::chrono::duration<double>(hr_clock::now() - start).count() < budget))
+	{
+		const auto entry = queue.top();
+		queue.pop();
+
+		if (!jobs[entry.slot].alive || jobs[entry.slot].generation != entry.generation)
+			continue;
+
+		first = false;
+
+		// Moved out while it runs, the step may submit new jobs and grow the job vector
+		auto step = std::move(jobs[entry.slot].step);
+		const bool done = step();
+
+		// The step may have destroyed its owner, cancelling the job
+		auto& job = jobs[entry.slot];
+		if (!job.alive || job.generation != entry.generation)
+			continue;
+
+		if (done)
+		{
+			release(entry.slot);
+		}
+		else
+		{
+			job.step = std::move(step);
+			push(entry.slot, frame);
+		}
+	}
+}
+
+void fen::WorkQueue::push(const std::uint32_t slot, const std::uint32_t frame)
+{
+	const auto& job = jobs[slot];
+	queue.push({ static_cast<std::int64_t>(job.priority) - frame, seq++, slot, job.generation });
+}
+
+void fen::WorkQueue::release(const std::uint32_t slot)
+{
+	auto& job = jobs[slot];
+
+	if (job.owner != nullptr)
+	{
+		if (job.prev_owned != no_slot)
+			jobs[job.prev_owned].next_owned = job.next_owned;
+		else
+			job.owner->work_head = job.next_owned;
+
+		if (job.next_owned != no_slot)
+			jobs[job.next_owned].prev_owned = job.prev_owned;
+	}
+
+	job.step = nullptr;
+	job.owner = nullptr;
+	job.alive = false;
+	++job.generation;
+
+	free_slots.push_back(slot);
+	--num_jobs;
+}
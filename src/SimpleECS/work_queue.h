@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace fen
+{
+class Component;
+
+/**
+ * \brief Resumable work run after the update cycle until the frame budget is spent.\n
+ * A job is a step function doing a bounded chunk of work and returning true once the job is finished.
+ * Jobs with higher priority run first. A job gains one priority point for every frame it waits, so lower priorities are not starved
+ */
+class WorkQueue
+{
+public:
+
+	using Step = std::function<bool()>;
+
+	/**
+	 * \brief Adds a job
+	 * \param owner Component cancelling the job when destroyed. May be nullptr
+	 */
+	void submit(Step step, int priority, Component* owner);
+
+	/**
+	 * \brief Removes every job owned by comp. Costs the number of jobs comp owns
+	 */
+	void cancel(Component* comp);
+
+	/**
+	 * \brief Runs job steps until budget seconds are spent. At least one step runs if there is any job
+	 * \param frame current engine frame, used to age the waiting jobs
+	 */
+	void run(double budget, std::uint32_t frame);
+
+	[[nodiscard]] std::size_t size() const noexcept { return num_jobs; }
+
+private:
+
+	static constexpr std::uint32_t no_slot = std::numeric_limits<std::uint32_t>::max();
+
+	struct Job
+	{
+		Step step;
+		Component* owner{ nullptr };
+
+		// Jobs of the same owner
+		std::uint32_t prev_owned{ no_slot };
+		std::uint32_t next_owned{ no_slot };
+
+		int priority{ 0 };
+		std::uint32_t generation{ 0 };
+		bool alive{ false };
+	};
+
+	struct Entry
+	{
+		// priority - frame it last ran. Comparing it is the same as comparing priority + frames waited
+		std::int64_t key;
+		std::uint64_t seq;
+		std::uint32_t slot;
+		std::uint32_t generation; // Entries of cancelled jobs are dropped when popped
+
+		bool operator<(const Entry& o) const noexcept { return key < o.key || (key == o.key && seq > o.seq); }
+	};
+
+	void push(std::uint32_t slot, std::uint32_t frame);
+	void release(std::uint32_t slot);
+
+	std::vector<Job> jobs;
+	std::vector<std::uint32_t> free_slots;
+	std::priority_queue<Entry> queue;
+
+	std::size_t num_jobs{ 0 };
+	std::uint64_t seq{ 0 };
+	std::uint32_t last_frame{ 0 };
+};
+
+} // namespace fen
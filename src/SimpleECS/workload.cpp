@@ -0,0 +1,349 @@
+#include "workload.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "component_factory.h"
+#include "engine.h"
+#include "logger.h"
+
+namespace
+{
+	constexpr char magic[4] = { 'F', 'E', 'N', 'W' };
+	constexpr std::size_t header_size = sizeof(magic) + 1;
+}
+
+fen::WorkloadRecorder::WorkloadRecorder(const std::string& path) : out(path, std::ios::binary | std::ios::trunc)
+{
+	if (!out)
+	{
+		FEN_LOG_ERROR("workload: cannot open {}", path);
+		return;
+	}
+
+	out.write(magic, sizeof(magic));
+	out.put(static_cast<char>(version));
+}
+
+fen::WorkloadRecorder::~WorkloadRecorder()
+{
+	flush();
+}
+
+void fen::WorkloadRecorder::add_entity(const EntityId id)
+{
+	entity_op(WorkloadOp::AddEntity, id);
+}
+
+void fen::WorkloadRecorder::entity_op(const WorkloadOp op, const EntityId id)
+{
+	buffer.push_back(static_cast<char>(op));
+	put_varint(id);
+}
+
+void fen::WorkloadRecorder::component_op(const WorkloadOp op, const EntityId id, const std::uint32_t type_id)
+{
+	if (type_id >= defined_types.size())
+		defined_types.resize(type_id + 1, false);
+
+	// Types are written by name, their ids may differ in the build replaying the log
+	if (!defined_types[type_id])
+	{
+		defined_types[type_id] = true;
+
+		const std::string name = ComponentFactory::Instance()->GetName(type_id);
+		buffer.push_back(static_cast<char>(WorkloadOp::DefineType));
+		put_varint(type_id);
+		put_varint(name.size());
+		buffer.insert(buffer.end(), name.begin(), name.end());
+	}
+
+	entity_op(op, id);
+	put_varint(type_id);
+}
+
+void fen::WorkloadRecorder::erase_on_no_components(const EntityId id, const bool b)
+{
+	entity_op(WorkloadOp::EraseOnNoComponents, id);
+	buffer.push_back(b ? 1 : 0);
+}
+
+void fen::WorkloadRecorder::init()
+{
+	buffer.push_back(static_cast<char>(WorkloadOp::Init));
+}
+
+void fen::WorkloadRecorder::frame(const double dt)
+{
+	std::uint64_t bits;
+	std::memcpy(&bits, &dt, sizeof(bits));
+
+	buffer.push_back(static_cast<char>(WorkloadOp::Frame));
+	for (int i = 0; i < 8; ++i)
+		buffer.push_back(static_cast<char>(bits >> (i * 8)));
+
+	// The stream keeps its own buffer, this does not reach the disk every frame
+	if (out.is_open())
+		out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	buffer.clear();
+}
+
+void fen::WorkloadRecorder::flush()
+{
+	if (!out.is_open())
+		return;
+
+	out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+	buffer.clear();
+	out.flush();
+}
+
+void fen::WorkloadRecorder::put_varint(std::uint64_t v)
+{
+	while (v >= 0x80)
+	{
+		buffer.push_back(static_cast<char>(v | 0x80));
+		v >>= 7;
+	}
+	buffer.push_back(static_cast<char>(v));
+}
+
+fen::WorkloadReplay::WorkloadReplay(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		FEN_LOG_ERROR("workload: cannot open {}", path);
+		return;
+	}
+
+	log.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+	if (log.size() < header_size || std::memcmp(log.data(), magic, sizeof(magic)) != 0 || log[sizeof(magic)] != WorkloadRecorder::version)
+	{
+		FEN_LOG_ERROR("workload: {} is not a version {} workload log", path, WorkloadRecorder::version);
+		return;
+	}
+
+	pos = header_size;
+	loaded = true;
+}
+
+std::uint32_t fen::WorkloadReplay::run(Engine& engine, const double fixed_dt)
+{
+	assert(loaded);
+
+	std::uint32_t num_frames = 0;
+	WorkloadOp marker = WorkloadOp::Init;
+	double dt = 0.0;
+
+	// Entities created before Engine::init are the starting entities
+	bool more = apply_until_marker(engine, marker, dt);
+	engine.init();
+	index_entities(engine);
+
+	// A log recorded after Engine::init has no Init record, its first records already belong to a frame
+	double apply_time = 0.0;
+	if (more && marker == WorkloadOp::Init)
+		apply_time = profiler.measure_time([&] { more = apply_until_marker(engine, marker, dt); });
+
+	while (more)
+	{
+		engine.set_fixed_dt(fixed_dt > 0.0 ? fixed_dt : dt);
+
+		bool running = true;
+		const double step_time = profiler.measure_time([&] { running = engine.step(); });
+
+		profiler.add_time<Apply>(apply_time);
+		profiler.add_time<Step>(step_time);
+		profiler.next_step();
+		frames.push_back({ apply_time, step_time, engine.entities.size() });
+		++num_frames;
+
+		if (!running)
+			break;
+
+		index_entities(engine);
+		apply_time = profiler.measure_time([&] { more = apply_until_marker(engine, marker, dt); });
+	}
+
+	engine.set_fixed_dt(0.0);
+	return num_frames;
+}
+
+bool fen::WorkloadReplay::apply_until_marker(Engine& engine, WorkloadOp& marker, double& dt)
+{
+	// The operations issued by the components during the replay are ignored, the ones in the log are not
+	engine.ignore_structural_ops = false;
+
+	bool found = false;
+	bool malformed = false;
+
+	while (!found && !malformed && pos < log.size())
+	{
+		const auto op = static_cast<WorkloadOp>(log[pos++]);
+		std::uint64_t id = 0;
+		std::uint64_t type = 0;
+
+		switch (op)
+		{
+		case WorkloadOp::DefineType:
+		{
+			std::uint64_t len = 0;
+			malformed = !read_varint(type) || !read_varint(len) || len > log.size() - pos;
+			if (malformed)
+				break;
+
+			if (type >= type_names.size())
+				type_names.resize(type + 1);
+			type_names[type].assign(reinterpret_cast<const char*>(log.data() + pos), len);
+			pos += len;
+			break;
+		}
+		case WorkloadOp::AddEntity:
+		{
+			malformed = !read_varint(id);
+			if (malformed)
+				break;
+
+			auto& e = engine.add_entity();
+			replay_ids[static_cast<EntityId>(id)] = e.get_id();
+			entities[e.get_id()] = &e;
+			break;
+		}
+		case WorkloadOp::AddComponent:
+		case WorkloadOp::DestroyComponent:
+		{
+			malformed = !read_varint(id) || !read_varint(type);
+			if (malformed)
+				break;
+
+			const auto e = find(id);
+			if (e == nullptr || type >= type_names.size() || type_names[type].empty())
+				++unresolved;
+			else if (op == WorkloadOp::AddComponent)
+				e->add_component(type_names[type].c_str());
+			else
+				e->destroy_component(type_names[type].c_str());
+			break;
+		}
+		case WorkloadOp::DestroyEntity:
+		{
+			malformed = !read_varint(id);
+			if (malformed)
+				break;
+
+			if (const auto e = find(id))
+				e->Destroy();
+			else
+				++unresolved;
+			break;
+		}
+		case WorkloadOp::EraseOnNoComponents:
+		{
+			malformed = !read_varint(id) || pos >= log.size();
+			if (malformed)
+				break;
+
+			const bool b = log[pos++] != 0;
+			if (const auto e = find(id))
+				e->set_erase_on_no_components(b);
+			else
+				++unresolved;
+			break;
+		}
+		case WorkloadOp::Init:
+			marker = op;
+			found = true;
+			break;
+		case WorkloadOp::Frame:
+		{
+			malformed = log.size() - pos < 8;
+			if (malformed)
+				break;
+
+			std::uint64_t bits = 0;
+			for (int i = 0; i < 8; ++i)
+				bits |= static_cast<std::uint64_t>(log[pos++]) << (i * 8);
+			std::memcpy(&dt, &bits, sizeof(dt));
+
+			marker = op;
+			found = true;
+			break;
+		}
+		default:
+			malformed = true;
+			break;
+		}
+	}
+
+	if (malformed)
+	{
+		FEN_LOG_ERROR("workload: malformed record at byte {}, replay stopped", pos);
+		pos = log.size();
+	}
+
+	engine.ignore_structural_ops = true;
+	return found;
+}
+
+void fen::WorkloadReplay::index_entities(Engine& engine)
+{
+	entities.clear();
+	for (auto& e : engine.entities)
+		entities[e.get_id()] = &e;
+}
+
+bool fen::WorkloadReplay::read_varint(std::uint64_t& v)
+{
+	v = 0;
+	for (unsigned shift = 0; pos < log.size() && shift < 64; shift += 7)
+	{
+		const auto byte = log[pos++];
+		v |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+fen::Entity* fen::WorkloadReplay::find(const std::uint64_t id)
+{
+	const auto replay_id = replay_ids.find(static_cast<EntityId>(id));
+	if (replay_id == replay_ids.end())
+		return nullptr;
+
+	const auto e = entities.find(replay_id->second);
+	return e != entities.end() ? e->second : nullptr;
+}
+
+void fen::WorkloadReplay::print(std::ostream& os) const
+{
+	os << "replayed frames: " << frames.size() << '\n';
+	if (frames.empty())
+		return;
+
+	std::vector<double> steps;
+	steps.reserve(frames.size());
+	for (const auto& f : frames)
+		steps.push_back(f.step);
+
+	const auto worst = std::max_element(steps.begin(), steps.end()) - steps.begin();
+	std::sort(steps.begin(), steps.end());
+	const auto percentile = [&steps](const double p) { return steps[static_cast<std::size_t>(p * static_cast<double>(steps.size() - 1))]; };
+
+	os << "avg apply: " << profiler.get_avg_time<Apply>() << ' ' << profiler.unit() << '\n';
+	os << "avg step: " << profiler.get_avg_time<Step>() << ' ' << profiler.unit() << '\n';
+	os << "step p50: " << percentile(0.5) << " p95: " << percentile(0.95) << " p99: " << percentile(0.99) << ' ' << profiler.unit() << '\n';
+	os << "worst step: " << steps.back() << ' ' << profiler.unit() << " at frame " << worst << '\n';
+	if (unresolved > 0)
+		os << "unresolved operations: " << unresolved << '\n';
+}
+
+void fen::WorkloadReplay::write_csv(std::ostream& os) const
+{
+	os << "frame,apply_" << profiler.unit() << ",step_" << profiler.unit() << ",entities\n";
+	for (std::size_t i = 0; i < frames.size(); ++i)
+		os << i << ',' << frames[i].apply << ',' << frames[i].step << ',' << frames[i].entities << '\n';
+}
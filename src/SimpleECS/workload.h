@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "change_tracker.h"
+#include "simple_profiler.h"
+
+namespace fen
+{
+class Engine;
+class Entity;
+
+/**
+ * \brief Records of a workload log.\n
+ * The log starts with the "FENW" magic and a version byte. Every record is an op byte followed by its operands,
+ * written as LEB128 varints: entity ids and component type ids
+ */
+enum class WorkloadOp : std::uint8_t
+{
+	DefineType,				// type id, name length, name bytes. Written before the first use of a type
+	AddEntity,				// entity id
+	AddComponent,			// entity id, type id
+	DestroyComponent,		// entity id, type id
+	DestroyEntity,			// entity id
+	EraseOnNoComponents,	// entity id, one byte flag
+	Init,					// Engine::init finished
+	Frame,					// Engine::step finished. Followed by its dt as a little endian double
+};
+
+/**
+ * \brief Writes the structural operations of a world to a compact binary log. See Engine::record_workload
+ */
+class WorkloadRecorder
+{
+public:
+
+	static constexpr std::uint8_t version = 1;
+
+	explicit WorkloadRecorder(const std::string& path);
+	~WorkloadRecorder();
+
+	WorkloadRecorder(const WorkloadRecorder& other) = delete;
+	WorkloadRecorder& operator=(const WorkloadRecorder& other) = delete;
+
+	[[nodiscard]] bool is_open() const { return out.is_open(); }
+
+	void add_entity(EntityId id);
+	void entity_op(WorkloadOp op, EntityId id);
+	void component_op(WorkloadOp op, EntityId id, std::uint32_t type_id);
+	void erase_on_no_components(EntityId id, bool b);
+	void init();
+
+	/**
+	 * \brief Ends a frame and hands the buffered records to the file
+	 */
+	void frame(double dt);
+
+	void flush();
+
+private:
+
+	void put_varint(std::uint64_t v);
+
+	std::ofstream out;
+	std::vector<char> buffer;
+	std::vector<bool> defined_types;
+};
+
+/**
+ * \brief Replays a workload log on a fresh engine, with a fixed dt, and reports per frame timings.\n
+ * The components run as usual but the structural operations they issue are ignored, the log already holds them.
+ * Operations are applied before the frame they were recorded in, so changes made from the update cycle happen
+ * at the start of the frame instead of in the middle of it
+ */
+class WorkloadReplay
+{
+public:
+
+	enum Timers : unsigned { Apply, Step, Num_Timers };
+
+	struct FrameTime
+	{
+		double apply;
+		double step;
+		std::size_t entities;
+	};
+
+	/**
+	 * \brief Loads the whole log. Check is_loaded afterwards
+	 */
+	explicit WorkloadReplay(const std::string& path);
+
+	[[nodiscard]] bool is_loaded() const noexcept { return loaded; }
+
+	/**
+	 * \brief Runs the log on engine, which must not be initialized yet
+	 * \param fixed_dt dt of every frame. 0 or less to use the recorded dt
+	 * \return number of frames run
+	 */
+	std::uint32_t run(Engine& engine, double fixed_dt = 1.0 / 60.0);
+
+	/**
+	 * \brief Prints average, percentiles and worst frame
+	 */
+	void print(std::ostream& os) const;
+
+	/**
+	 * \brief Writes one line per frame: frame, apply ms, step ms, entities
+	 */
+	void write_csv(std::ostream& os) const;
+
+	[[nodiscard]] const std::vector<FrameTime>& get_frames() const noexcept { return frames; }
+
+	/**
+	 * \return operations that referenced an entity or type unknown to the replay
+	 */
+	[[nodiscard]] std::size_t get_unresolved() const noexcept { return unresolved; }
+
+private:
+
+	// Applies the records up to the next Init or Frame record. Returns that record, or nothing at the end of the log
+	bool apply_until_marker(Engine& engine, WorkloadOp& marker, double& dt);
+
+	// Entities of the engine by id. Rebuilt after every step because entities move when they are initialized
+	void index_entities(Engine& engine);
+
+	[[nodiscard]] bool read_varint(std::uint64_t& v);
+	[[nodiscard]] Entity* find(std::uint64_t id);
+
+	std::vector<std::uint8_t> log;
+	std::size_t pos{ 0 };
+	bool loaded{ false };
+
+	std::vector<std::string> type_names;
+
+	// Recorded entity id to the id of the entity created by the replay
+	std::unordered_map<EntityId, EntityId> replay_ids;
+	std::unordered_map<EntityId, Entity*> entities;
+	std::size_t unresolved{ 0 };
+
+	SimpleProfiler<Num_Timers, double, std::milli> profiler;
+	std::vector<FrameTime> frames;
+};
+
+} // namespace fen
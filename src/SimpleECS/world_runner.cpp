@@ -0,0 +1,51 @@
+#include "world_runner.h"
+
+#include <algorithm>
+#include <thread>
+
+fen::WorldRunner::WorldRunner(const unsigned num_threads_) : num_threads(num_threads_)
+{
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+}
+
+fen::Engine& fen::WorldRunner::add_world()
+{
+	worlds.emplace_back(std::make_unique<Engine>());
+	return *worlds.back();
+}
+
+void fen::WorldRunner::run()
+{
+	const auto shards = std::min<std::size_t>(num_threads, worlds.size());
+	if (shards == 0)
+		return;
+
+	// The calling thread runs the first shard
+	std::vector<std::thread> threads;
+	threads.reserve(shards - 1);
+	for (unsigned shard = 1; shard < shards; ++shard)
+		threads.emplace_back(&WorldRunner::run_shard, this, shard);
+
+	run_shard(0);
+
+	for (auto& t : threads)
+		t.join();
+}
+
+void fen::WorldRunner::run_shard(const unsigned shard)
+{
+	const auto stride = std::min<std::size_t>(num_threads, worlds.size());
+
+	for (auto i = static_cast<std::size_t>(shard); i < worlds.size(); i += stride)
+		worlds[i]->init();
+
+	// Interleave the worlds of the shard one frame at a time until all of them exit
+	bool running = true;
+	while (running)
+	{
+		running = false;
+		for (auto i = static_cast<std::size_t>(shard); i < worlds.size(); i += stride)
+			running = worlds[i]->step() || running;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "engine.h"
+
+namespace fen
+{
+
+/**
+ * \brief Hosts several independent worlds and steps them in parallel. Worlds are sharded statically across the threads,
+ * so every world is always stepped by the same thread
+ */
+class WorldRunner
+{
+public:
+
+	/**
+	 * \param num_threads_ Threads used to step the worlds. 0 uses the hardware concurrency
+	 */
+	explicit WorldRunner(unsigned num_threads_ = 0);
+
+	/**
+	 * \brief Creates a new world owned by the runner. Add its starting entities before calling run
+	 */
+	[[nodiscard]] Engine& add_world();
+
+	/**
+	 * \brief Initializes every world and steps them until all of them exit
+	 */
+	void run();
+
+	[[nodiscard]] std::size_t num_worlds() const noexcept { return worlds.size(); }
+	[[nodiscard]] unsigned get_num_threads() const noexcept { return num_threads; }
+
+private:
+
+	// Steps the worlds shard, shard + num_threads, ... until they exit
+	void run_shard(unsigned shard);
+
+	std::vector<std::unique_ptr<Engine>> worlds;
+	unsigned num_threads;
+};
+
+} // namespace fen